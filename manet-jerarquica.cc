@@ -7,19 +7,48 @@
 #include "ns3/internet-module.h"
 #include "ns3/applications-module.h"
 #include "ns3/olsr-helper.h"
+#include "ns3/olsr-routing-protocol.h"
 #include "ns3/flow-monitor-helper.h"
 #include "ns3/netanim-module.h"
 #include "ns3/ipv4-flow-classifier.h"
 #include "ns3/ipv4-static-routing-helper.h"
+#include "ns3/spectrum-module.h"
+#include "ns3/propagation-module.h"
 
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <deque>
+#include <queue>
+#include <random>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <map>
+#include <tuple>
+#include <functional>
+#include <set>
+#include <unordered_map>
+#include <limits>
 #include <cmath>
+#include <algorithm>
+#include <iterator>
 #include <sstream>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <typeindex>
+#include <cxxabi.h>
 
 using namespace ns3;
 NS_LOG_COMPONENT_DEFINE("ManetHierarchical_OpA");
@@ -39,258 +68,4315 @@ struct SimulationParams {
     double simulationTime;
     double leaderSpeed;
     double interClusterDistance;
+    double backhaulRange;    // leader-leader range used by the connectivity monitor
+    double accessRange;      // subordinate-leader range used by the connectivity monitor
+    double monitorInterval;
+    std::string connectivityMode; // poll | event | both
+    uint32_t nodesPerCluster;     // 0 = keep each cluster's own numNodes
+    std::string trajectory;       // empty = keep each cluster's own trajectoryType
+    uint32_t rngRun;              // 0 until resolved: --rngRun if given, else ns-3's RngRun global
+    bool enableAnim;
+    std::string summaryFile;      // one-row CSV with the run's metrics (used by the sweep driver)
+    uint32_t forkReplications;    // >0: build once, fork this many replicas before Simulator::Run
+    std::string layout;           // manual | grid | random | poisson
+    std::string clusterSize;      // generated clusters: fixed:N | uniform:MIN:MAX | poisson:MEAN
+    std::string trajectoryMix;    // generated clusters: e.g. circular:2,zigzag:1
+    std::string traffic;          // full | nearest | gravity | random | hotspot
+    uint32_t trafficK;
+    std::string flowRate;
+    std::string trafficProfile;   // onoff (OnOff + PacketSink per leader) | cbr | poisson | bursty | saturating (traffic engine)
+    std::string trafficEndpoints; // leader | subordinate | mixed
+    double burstOn;               // bursty profile: mean ON period (s)
+    double burstOff;              // bursty profile: mean OFF period (s)
+    std::string traceMode;        // netanim | compact | none
+    double traceMinMove;          // compact trace: minimum displacement between position samples (m)
+    std::string outputs;          // writer-backed sinks: report (stdout), flows (file), windows (CSV)
+    double metricsWindow;         // windowed flow metrics bin width (s), 0 disables
+    bool graphAnalytics;          // two-tier components, reachability, detachments and articulation leaders per monitor tick
+    bool steadyState;             // stop once the windowed series reach steady state with the target precision
+    double steadyPrecision;       // relative 95% CI half-width required on every series
+    double steadyWarmup;          // windows before this time are never used (s)
+    uint32_t steadyBatches;       // number of batch means
+    std::string channel;          // yans | spectrum (unculled baseline) | culled
+    std::string cullThreshold;    // culled channel: "sensitivity", "ed" or a best-case receive power in dBm
+    std::string linkMode;         // wifi (802.11a stack) | fast (distance-threshold SimpleNetDevice)
+    std::string fastRate;         // fast mode: device data rate
+    double fastLoss;              // fast mode: per-frame drop probability
+    std::string recordMobility;   // write the generated trajectories to this binary trace
+    std::string replayMobility;   // follow a recorded binary trace instead of generating mobility
+    bool summaryFlows;            // add per-flow PDR/throughput columns to the run summary
+    bool profile;                 // phase timings, event counts and peak RSS to a JSON file
+    std::string routing;          // flat (OLSR on every leader interface) | hierarchical (OLSR on backhaul + HNA) | oracle
+    bool asyncOutput;             // write sinks from a background thread
+    bool compressOutput;          // gzip file sinks
     std::vector<ClusterConfig> clusters;
 };
 
+// Packed key for an unordered node pair (i < j)
+inline uint64_t PairKey(uint32_t i, uint32_t j) { return ((uint64_t)i << 32) | j; }
+
 struct ConnectivityMetrics {
     uint32_t totalChecks;
     uint32_t connectedChecks;
-    std::map<std::pair<uint32_t, uint32_t>, uint32_t> pairConnectivity;
-    ConnectivityMetrics() : totalChecks(0), connectedChecks(0) {}
+    std::unordered_map<uint64_t, uint32_t> pairConnectivity; // PairKey(i,j) -> samples in range
+    uint64_t subordinateSamples;
+    uint64_t attachedSamples;
+    uint64_t accessLinkSamples;
+    ConnectivityMetrics() : totalChecks(0), connectedChecks(0), subordinateSamples(0), attachedSamples(0), accessLinkSamples(0) {}
     double GetConnectivityRatio() const {
         return totalChecks > 0 ? (double)connectedChecks / totalChecks : 0.0;
     }
+    double GetAttachmentRatio() const {
+        return subordinateSamples > 0 ? (double)attachedSamples / subordinateSamples : 0.0;
+    }
+};
+
+ConnectivityMetrics globalConnectivity;
+
+// --- Crear directorio de salida junto al .cc (similar a manet-proyect-batman.cc) ---
+static std::string
+CreateOutputDirectory (const std::string &suffix = "")
+{
+    std::string sourceFile = __FILE__;
+    size_t lastSlash = sourceFile.find_last_of("/\\");
+    std::string sourceDir = (lastSlash != std::string::npos) ? sourceFile.substr(0, lastSlash) : ".";
+    std::string outDir = sourceDir + "/manet-jerarquica";
+    if (!suffix.empty()) outDir += "-" + suffix;
+    std::string mkdirCmd = "mkdir -p " + outDir;
+    (void)system(mkdirCmd.c_str());
+    NS_LOG_UNCOND("Directorio de salida: " << outDir);
+    return outDir;
+}
+
+// Mobility models whose motion is piecewise linear expose the segment active at time t
+// (t >= Now), so trackers can solve range crossings analytically instead of sampling.
+class PiecewiseLinearMotion
+{
+public:
+    virtual ~PiecewiseLinearMotion() {}
+    // Position and velocity at t, and the absolute time at which that velocity changes
+    virtual void GetSegment(Time t, Vector &position, Vector &velocity, Time &segmentEnd) const = 0;
+};
+
+// ----- Custom mobility model for leaders -----
+// The patrol is a closed loop over the waypoints. Instead of scheduling one event per
+// waypoint, the loop is flattened into a cumulative arc-length table at SetTrajectory()
+// time and the position at any instant is resolved in closed form (O(log n) lookup).
+class LeaderTrajectoryMobilityModel : public MobilityModel, public PiecewiseLinearMotion
+{
+public:
+    static TypeId GetTypeId()
+    {
+        static TypeId tid = TypeId("LeaderTrajectoryMobilityModel")
+            .SetParent<MobilityModel>()
+            .SetGroupName("Mobility")
+            .AddConstructor<LeaderTrajectoryMobilityModel>();
+        return tid;
+    }
+
+    LeaderTrajectoryMobilityModel() : m_radius(0.0), m_trajectoryType("circular"), m_speed(5.0), m_loopLength(0.0), m_notifyCourseChange(false)
+    {
+        m_offset = Vector(0,0,0);
+    }
+
+    void SetTrajectory(const std::string &type, const Vector &center, double radius, double speed)
+    {
+        m_trajectoryType = type;
+        m_center = center;
+        m_radius = radius;
+        m_speed = speed;
+        m_offset = Vector(0,0,0);
+        m_start = Simulator::Now();
+        GenerateWaypoints();
+        BuildArcLengthTable();
+        ScheduleCourseChange();
+    }
+
+    // CourseChange is only fired at waypoints when a consumer asks for it (e.g. NetAnim);
+    // otherwise the model keeps zero pending events in the scheduler.
+    void EnableCourseChangeNotifications(bool enable)
+    {
+        m_notifyCourseChange = enable;
+        m_courseChangeEvent.Cancel();
+        ScheduleCourseChange();
+    }
+
+    virtual Ptr<MobilityModel> Copy() const override {
+        Ptr<LeaderTrajectoryMobilityModel> copy = CreateObject<LeaderTrajectoryMobilityModel>();
+        copy->m_trajectoryType = m_trajectoryType;
+        copy->m_center = m_center;
+        copy->m_radius = m_radius;
+        copy->m_speed = m_speed;
+        copy->m_start = m_start;
+        copy->m_offset = m_offset;
+        copy->m_waypoints = m_waypoints;
+        copy->m_cumLength = m_cumLength;
+        copy->m_loopLength = m_loopLength;
+        return copy;
+    }
+
+    virtual void GetSegment(Time t, Vector &position, Vector &velocity, Time &segmentEnd) const override
+    {
+        Vector p = PathPosition(t);
+        position = Vector(p.x + m_offset.x, p.y + m_offset.y, p.z + m_offset.z);
+        uint32_t k; double s;
+        if (!LocateSegment(t, k, s)) {
+            velocity = Vector(0,0,0);
+            segmentEnd = Time::Max();
+            return;
+        }
+        double remaining = RemainingOnSegment(k, s);
+        velocity = SegmentVelocity(k);
+        segmentEnd = t + Seconds(remaining / m_speed);
+    }
+
+protected:
+    virtual void DoDispose() override
+    {
+        m_courseChangeEvent.Cancel();
+        MobilityModel::DoDispose();
+    }
+
+private:
+    void GenerateWaypoints()
+    {
+        m_waypoints.clear();
+        if (m_trajectoryType == "circular") {
+            int n = 12;
+            for (int i=0;i<n;i++) {
+                double ang = 2.0*M_PI*i/n;
+                m_waypoints.push_back(Vector(m_center.x + m_radius*cos(ang),
+                                             m_center.y + m_radius*sin(ang), 0.0));
+            }
+        } else if (m_trajectoryType == "linear") {
+            m_waypoints.push_back(Vector(m_center.x - m_radius, m_center.y, 0));
+            m_waypoints.push_back(Vector(m_center.x + m_radius, m_center.y, 0));
+        } else if (m_trajectoryType == "rectangular") {
+            double h = m_radius * 0.7;
+            m_waypoints.push_back(Vector(m_center.x - h, m_center.y - h, 0));
+            m_waypoints.push_back(Vector(m_center.x + h, m_center.y - h, 0));
+            m_waypoints.push_back(Vector(m_center.x + h, m_center.y + h, 0));
+            m_waypoints.push_back(Vector(m_center.x - h, m_center.y + h, 0));
+        } else { // zigzag default
+            int seg = 4;
+            double seglen = (2.0*m_radius)/seg;
+            for (int i=0;i<=seg;i++) {
+                double x = m_center.x - m_radius + i*seglen;
+                double y = m_center.y + ((i%2==0)? -m_radius*0.3 : m_radius*0.3);
+                m_waypoints.push_back(Vector(x,y,0));
+            }
+        }
+    }
+
+    // m_cumLength[k] = distance travelled from waypoint 0 to waypoint k along the loop;
+    // the last entry closes the loop back to waypoint 0.
+    void BuildArcLengthTable()
+    {
+        uint32_t n = m_waypoints.size();
+        m_cumLength.assign(n + 1, 0.0);
+        for (uint32_t k=0;k<n;++k) {
+            m_cumLength[k+1] = m_cumLength[k] + CalculateDistance(m_waypoints[k], m_waypoints[(k+1) % n]);
+        }
+        m_loopLength = n > 0 ? m_cumLength[n] : 0.0;
+    }
+
+    // Segment k (waypoint k -> k+1) and arc length s travelled inside the loop at time t.
+    // Returns false when the leader does not move (no waypoints, zero speed or zero-length loop).
+    bool LocateSegment(Time t, uint32_t &k, double &s) const
+    {
+        if (m_waypoints.empty() || m_loopLength <= 0.0 || m_speed <= 0.0) return false;
+        double travelled = std::max(0.0, (t - m_start).GetSeconds()) * m_speed;
+        s = std::fmod(travelled, m_loopLength);
+        auto it = std::upper_bound(m_cumLength.begin(), m_cumLength.end(), s);
+        k = std::min<uint32_t>(std::max<int64_t>(0, (it - m_cumLength.begin()) - 1), m_waypoints.size() - 1);
+        return true;
+    }
+
+    Vector PathPosition(Time t) const
+    {
+        uint32_t k; double s;
+        if (!LocateSegment(t, k, s)) return m_waypoints.empty() ? m_center : m_waypoints[0];
+        const Vector &a = m_waypoints[k];
+        const Vector &b = m_waypoints[(k+1) % m_waypoints.size()];
+        double len = m_cumLength[k+1] - m_cumLength[k];
+        double f = len > 0.0 ? (s - m_cumLength[k]) / len : 0.0;
+        return Vector(a.x + (b.x - a.x)*f, a.y + (b.y - a.y)*f, a.z + (b.z - a.z)*f);
+    }
+
+    // Distance left on segment k at arc length s. Right at a waypoint, k moves on to the
+    // next non-degenerate segment so callers never get a zero-length step.
+    double RemainingOnSegment(uint32_t &k, double s) const
+    {
+        double remaining = m_cumLength[k+1] - s;
+        for (uint32_t i=0; i<m_waypoints.size() && remaining < 1e-6; ++i) {
+            k = (k + 1) % m_waypoints.size();
+            remaining += m_cumLength[k+1] - m_cumLength[k];
+        }
+        return remaining;
+    }
+
+    Vector SegmentVelocity(uint32_t k) const
+    {
+        const Vector &a = m_waypoints[k];
+        const Vector &b = m_waypoints[(k+1) % m_waypoints.size()];
+        double len = m_cumLength[k+1] - m_cumLength[k];
+        if (len <= 0.0) return Vector(0,0,0);
+        return Vector((b.x - a.x)/len*m_speed, (b.y - a.y)/len*m_speed, (b.z - a.z)/len*m_speed);
+    }
+
+    void ScheduleCourseChange()
+    {
+        if (!m_notifyCourseChange) return;
+        uint32_t k; double s;
+        if (!LocateSegment(Simulator::Now(), k, s)) return;
+        double remaining = RemainingOnSegment(k, s);
+        m_courseChangeEvent = Simulator::Schedule(Seconds(remaining / m_speed), &LeaderTrajectoryMobilityModel::FireCourseChange, this);
+    }
+
+    void FireCourseChange()
+    {
+        NotifyCourseChange();
+        ScheduleCourseChange();
+    }
+
+    virtual Vector DoGetPosition() const override
+    {
+        Vector p = PathPosition(Simulator::Now());
+        return Vector(p.x + m_offset.x, p.y + m_offset.y, p.z + m_offset.z);
+    }
+    // An explicit SetPosition translates the whole patrol so it continues from the new point.
+    virtual void DoSetPosition(const Vector &position) override
+    {
+        Vector p = PathPosition(Simulator::Now());
+        m_offset = Vector(position.x - p.x, position.y - p.y, position.z - p.z);
+        NotifyCourseChange();
+    }
+    virtual Vector DoGetVelocity() const override
+    {
+        uint32_t k; double s;
+        if (!LocateSegment(Simulator::Now(), k, s)) return Vector(0,0,0);
+        return SegmentVelocity(k);
+    }
+
+    Vector m_center;
+    Vector m_offset;
+    double m_radius;
+    std::string m_trajectoryType;
+    double m_speed;
+    Time m_start;
+    std::vector<Vector> m_waypoints;
+    std::vector<double> m_cumLength;
+    double m_loopLength;
+    bool m_notifyCourseChange;
+    EventId m_courseChangeEvent;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(LeaderTrajectoryMobilityModel);
+
+// ----- Reference-point group mobility for subordinates -----
+// A subordinate is its leader's position plus an own offset that random-walks inside a
+// disk of radius m_radius. Offset legs are drawn lazily when a query passes the end of the
+// last leg, so the model schedules no events and the cluster follows the leader
+// continuously. Legs are drawn in order, so the trajectory does not depend on when (or how
+// often) the position is queried. The velocity changes whenever the leader's segment or the
+// offset leg ends; CourseChange reports those breakpoints only when notifications are
+// enabled, as for the leader.
+class GroupMemberMobilityModel : public MobilityModel, public PiecewiseLinearMotion
+{
+public:
+    static TypeId GetTypeId()
+    {
+        static TypeId tid = TypeId("GroupMemberMobilityModel")
+            .SetParent<MobilityModel>()
+            .SetGroupName("Mobility")
+            .AddConstructor<GroupMemberMobilityModel>()
+            .AddAttribute("Radius", "Maximum distance of the offset from the reference (m)",
+                          DoubleValue(40.0), MakeDoubleAccessor(&GroupMemberMobilityModel::m_radius), MakeDoubleChecker<double>(0.0))
+            .AddAttribute("Speed", "Speed of the offset random walk (m/s)",
+                          DoubleValue(2.0), MakeDoubleAccessor(&GroupMemberMobilityModel::m_speed), MakeDoubleChecker<double>(0.0))
+            .AddAttribute("StepDistance", "Length of each random-walk leg (m)",
+                          DoubleValue(8.0), MakeDoubleAccessor(&GroupMemberMobilityModel::m_step), MakeDoubleChecker<double>(0.0));
+        return tid;
+    }
+
+    GroupMemberMobilityModel() : m_radius(40.0), m_speed(2.0), m_step(8.0), m_notifyCourseChange(false)
+    {
+        m_rng = CreateObject<UniformRandomVariable>();
+    }
+
+    void SetReference(Ptr<MobilityModel> reference, const Vector &initialOffset)
+    {
+        m_reference = reference;
+        m_legs.clear();
+        m_legs.push_back({initialOffset, initialOffset, Simulator::Now(), Simulator::Now()});
+        m_courseChangeEvent.Cancel();
+        ScheduleCourseChange();
+    }
+
+    Ptr<MobilityModel> GetReference() const { return m_reference; }
+
+    // One pending event per member, at the next breakpoint of its motion (leader segment or
+    // offset leg); off by default so the model keeps zero pending events in the scheduler
+    void EnableCourseChangeNotifications(bool enable)
+    {
+        m_notifyCourseChange = enable;
+        m_courseChangeEvent.Cancel();
+        ScheduleCourseChange();
+    }
+
+    virtual Ptr<MobilityModel> Copy() const override {
+        Ptr<GroupMemberMobilityModel> copy = CreateObject<GroupMemberMobilityModel>();
+        copy->m_reference = m_reference;
+        copy->m_radius = m_radius;
+        copy->m_speed = m_speed;
+        copy->m_step = m_step;
+        copy->m_legs = m_legs;
+        return copy;
+    }
+
+    virtual void GetSegment(Time t, Vector &position, Vector &velocity, Time &segmentEnd) const override
+    {
+        Vector rp(0,0,0), rv(0,0,0);
+        Time rend = Time::Max();
+        const PiecewiseLinearMotion *ref = m_reference ? dynamic_cast<const PiecewiseLinearMotion*>(PeekPointer(m_reference)) : nullptr;
+        if (ref) {
+            ref->GetSegment(t, rp, rv, rend);
+        } else if (m_reference) {
+            rp = m_reference->GetPosition();
+            rv = m_reference->GetVelocity();
+            rend = Simulator::Now() + Seconds(1.0); // not piecewise linear: only trust it briefly
+        }
+        const Leg &leg = LegAt(t);
+        Vector off = OffsetOn(leg, t), ov = LegVelocity(leg);
+        position = Vector(rp.x + off.x, rp.y + off.y, rp.z + off.z);
+        velocity = Vector(rv.x + ov.x, rv.y + ov.y, rv.z + ov.z);
+        segmentEnd = std::min(rend, leg.end > t ? leg.end : Time::Max());
+    }
+
+protected:
+    virtual void DoDispose() override
+    {
+        m_courseChangeEvent.Cancel();
+        m_reference = nullptr;
+        MobilityModel::DoDispose();
+    }
+
+private:
+    struct Leg {
+        Vector from;
+        Vector to;
+        Time start;
+        Time end;
+    };
+
+    // Leg covering time t (t >= Now). Legs are drawn up to t; those that ended before Now
+    // are dropped, so the history stays a handful of entries.
+    const Leg &LegAt(Time t) const
+    {
+        Time now = Simulator::Now();
+        while (m_legs.size() > 1 && m_legs.front().end <= now) m_legs.pop_front();
+        if (m_speed > 0.0 && m_step > 0.0 && m_radius > 0.0) {
+            while (m_legs.back().end <= t) DrawLeg();
+        }
+        for (const Leg &leg : m_legs) {
+            if (t < leg.end) return leg;
+        }
+        return m_legs.back();
+    }
+
+    void DrawLeg() const
+    {
+        Vector from = m_legs.back().to;
+        Time start = m_legs.back().end;
+        double ang = m_rng->GetValue(0, 2*M_PI);
+        Vector to(from.x + m_step*cos(ang), from.y + m_step*sin(ang), 0);
+        if (to.x*to.x + to.y*to.y > m_radius*m_radius) {
+            // Leaving the disk: head for a random point inside it instead
+            double r = m_radius * std::sqrt(m_rng->GetValue(0, 1));
+            double a = m_rng->GetValue(0, 2*M_PI);
+            to = Vector(r*cos(a), r*sin(a), 0);
+        }
+        double len = CalculateDistance(from, to);
+        m_legs.push_back({from, to, start, start + Seconds(std::max(len / m_speed, 1e-3))});
+    }
+
+    void ScheduleCourseChange()
+    {
+        if (!m_notifyCourseChange) return;
+        Vector p, v;
+        Time now = Simulator::Now(), end;
+        GetSegment(now, p, v, end);
+        if (end == Time::Max() || end <= now) return;
+        m_courseChangeEvent = Simulator::Schedule(end - now, &GroupMemberMobilityModel::FireCourseChange, this);
+    }
+
+    void FireCourseChange()
+    {
+        NotifyCourseChange();
+        ScheduleCourseChange();
+    }
+
+    static Vector OffsetOn(const Leg &leg, Time t)
+    {
+        double dur = (leg.end - leg.start).GetSeconds();
+        if (dur <= 0.0) return leg.to;
+        double f = std::min(1.0, std::max(0.0, (t - leg.start).GetSeconds() / dur));
+        return Vector(leg.from.x + (leg.to.x - leg.from.x)*f, leg.from.y + (leg.to.y - leg.from.y)*f, 0);
+    }
+
+    static Vector LegVelocity(const Leg &leg)
+    {
+        double dur = (leg.end - leg.start).GetSeconds();
+        if (dur <= 0.0) return Vector(0,0,0);
+        return Vector((leg.to.x - leg.from.x)/dur, (leg.to.y - leg.from.y)/dur, 0);
+    }
+
+    virtual Vector DoGetPosition() const override
+    {
+        Vector ref = m_reference ? m_reference->GetPosition() : Vector(0,0,0);
+        Time now = Simulator::Now();
+        Vector off = OffsetOn(LegAt(now), now);
+        return Vector(ref.x + off.x, ref.y + off.y, ref.z + off.z);
+    }
+    virtual void DoSetPosition(const Vector &position) override
+    {
+        Vector ref = m_reference ? m_reference->GetPosition() : Vector(0,0,0);
+        SetReference(m_reference, Vector(position.x - ref.x, position.y - ref.y, 0));
+        NotifyCourseChange();
+    }
+    virtual Vector DoGetVelocity() const override
+    {
+        Vector v = m_reference ? m_reference->GetVelocity() : Vector(0,0,0);
+        Vector ov = LegVelocity(LegAt(Simulator::Now()));
+        return Vector(v.x + ov.x, v.y + ov.y, v.z);
+    }
+    virtual int64_t DoAssignStreams(int64_t stream) override
+    {
+        m_rng->SetStream(stream);
+        return 1;
+    }
+
+    Ptr<MobilityModel> m_reference;
+    Ptr<UniformRandomVariable> m_rng;
+    double m_radius;
+    double m_speed;
+    double m_step;
+    mutable std::deque<Leg> m_legs;
+    bool m_notifyCourseChange;
+    EventId m_courseChangeEvent;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(GroupMemberMobilityModel);
+
+// ----- Helper functions -----
+void SetupLeaderMobility(NodeContainer &leaders, const std::vector<ClusterConfig> &clusters, double speed)
+{
+    for (uint32_t i=0;i<leaders.GetN();++i) {
+        Ptr<Node> n = leaders.Get(i);
+        Ptr<LeaderTrajectoryMobilityModel> model = CreateObject<LeaderTrajectoryMobilityModel>();
+        uint32_t idx = i % clusters.size();
+        model->SetTrajectory(clusters[idx].trajectoryType, clusters[idx].leaderStartPos, clusters[idx].mobilityRadius, speed);
+        n->AggregateObject(model);
+    }
+    NS_LOG_INFO("SetupLeaderMobility: líderes configurados");
+}
+
+// ----- Spatial-grid connectivity engine -----
+// Caches the mobility model of every tracked node. On each Update() positions are copied
+// into flat x/y arrays and bucketed (counting sort, CSR layout) into a uniform grid whose
+// cells are at least maxRange wide, so a link query only visits the 3x3 cells around a node.
+class ConnectivityEngine
+{
+public:
+    ConnectivityEngine(const NodeContainer &nodes, double maxRange)
+        : m_range(maxRange), m_cell(maxRange), m_minX(0), m_minY(0), m_cols(1), m_rows(1)
+    {
+        for (uint32_t i=0;i<nodes.GetN();++i) m_mobility.push_back(nodes.Get(i)->GetObject<MobilityModel>());
+        uint32_t n = m_mobility.size();
+        m_x.assign(n, 0.0);
+        m_y.assign(n, 0.0);
+        m_cellOf.assign(n, 0);
+        m_sorted.assign(n, 0);
+    }
+
+    uint32_t GetN() const { return m_mobility.size(); }
+    double GetRange() const { return m_range; }
+    double GetX(uint32_t i) const { return m_x[i]; }
+    double GetY(uint32_t i) const { return m_y[i]; }
+
+    bool InRange(uint32_t i, uint32_t j) const
+    {
+        double dx = m_x[i] - m_x[j], dy = m_y[i] - m_y[j];
+        return dx*dx + dy*dy <= m_range*m_range;
+    }
+
+    // Optional reference node per entry (e.g. each subordinate's leader), see CountAttached()
+    void SetHeads(const std::vector<uint32_t> &heads) { m_heads = heads; }
+
+    // Snapshot positions and rebuild the grid
+    void Update()
+    {
+        uint32_t n = GetN();
+        if (n == 0) return;
+        double maxX = -std::numeric_limits<double>::max(), maxY = maxX;
+        m_minX = m_minY = std::numeric_limits<double>::max();
+        for (uint32_t i=0;i<n;++i) {
+            Vector p = m_mobility[i] ? m_mobility[i]->GetPosition() : Vector(0,0,0);
+            m_x[i] = p.x; m_y[i] = p.y;
+            m_minX = std::min(m_minX, p.x); maxX = std::max(maxX, p.x);
+            m_minY = std::min(m_minY, p.y); maxY = std::max(maxY, p.y);
+        }
+        // Keep the grid O(n) cells: wider cells only add candidates, they never drop links
+        m_cell = std::max(m_range, 1e-6);
+        for (;;) {
+            m_cols = (uint32_t)std::floor((maxX - m_minX) / m_cell) + 1;
+            m_rows = (uint32_t)std::floor((maxY - m_minY) / m_cell) + 1;
+            if ((uint64_t)m_cols*m_rows <= std::max<uint64_t>(1024, 4ull*n)) break;
+            m_cell *= 2.0;
+        }
+        m_cellStart.assign(m_cols*m_rows + 1, 0);
+        for (uint32_t i=0;i<n;++i) {
+            m_cellOf[i] = CellIndex(m_x[i], m_y[i]);
+            m_cellStart[m_cellOf[i] + 1]++;
+        }
+        for (uint32_t c=0;c<m_cols*m_rows;++c) m_cellStart[c+1] += m_cellStart[c];
+        m_fill.assign(m_cellStart.begin(), m_cellStart.end() - 1);
+        for (uint32_t i=0;i<n;++i) m_sorted[m_fill[m_cellOf[i]]++] = i;
+    }
+
+    // Calls f(i, j) once for every pair i < j within range; returns the number of links
+    template <typename F>
+    uint32_t ForEachLink(F f) const
+    {
+        uint32_t links = 0;
+        for (uint32_t i=0;i<GetN();++i) {
+            int32_t cx = m_cellOf[i] % m_cols, cy = m_cellOf[i] / m_cols;
+            for (int32_t y=std::max(cy-1,0); y<=std::min<int32_t>(cy+1, m_rows-1); ++y) {
+                for (int32_t x=std::max(cx-1,0); x<=std::min<int32_t>(cx+1, m_cols-1); ++x) {
+                    uint32_t c = y*m_cols + x;
+                    for (uint32_t k=m_cellStart[c]; k<m_cellStart[c+1]; ++k) {
+                        uint32_t j = m_sorted[k];
+                        if (j <= i || !InRange(i, j)) continue;
+                        f(i, j);
+                        links++;
+                    }
+                }
+            }
+        }
+        return links;
+    }
+
+    // Calls f(j) for every j != i within range of i
+    template <typename F>
+    void ForEachNeighbor(uint32_t i, F f) const
+    {
+        int32_t cx = m_cellOf[i] % m_cols, cy = m_cellOf[i] / m_cols;
+        for (int32_t y=std::max(cy-1,0); y<=std::min<int32_t>(cy+1, m_rows-1); ++y) {
+            for (int32_t x=std::max(cx-1,0); x<=std::min<int32_t>(cx+1, m_cols-1); ++x) {
+                uint32_t c = y*m_cols + x;
+                for (uint32_t k=m_cellStart[c]; k<m_cellStart[c+1]; ++k) {
+                    uint32_t j = m_sorted[k];
+                    if (j != i && InRange(i, j)) f(j);
+                }
+            }
+        }
+    }
+
+    // Entries within range of their head (entries that are their own head are skipped)
+    uint32_t CountAttached(uint32_t &members) const
+    {
+        uint32_t attached = 0;
+        members = 0;
+        for (uint32_t i=0;i<m_heads.size() && i<GetN();++i) {
+            if (m_heads[i] == i) continue;
+            members++;
+            if (InRange(i, m_heads[i])) attached++;
+        }
+        return attached;
+    }
+
+private:
+    uint32_t CellIndex(double x, double y) const
+    {
+        uint32_t cx = std::min<uint32_t>((uint32_t)((x - m_minX) / m_cell), m_cols - 1);
+        uint32_t cy = std::min<uint32_t>((uint32_t)((y - m_minY) / m_cell), m_rows - 1);
+        return cy*m_cols + cx;
+    }
+
+    std::vector<Ptr<MobilityModel>> m_mobility;
+    std::vector<double> m_x;
+    std::vector<double> m_y;
+    std::vector<uint32_t> m_heads;
+    double m_range;
+    double m_cell;
+    double m_minX;
+    double m_minY;
+    uint32_t m_cols;
+    uint32_t m_rows;
+    std::vector<uint32_t> m_cellOf;
+    std::vector<uint32_t> m_cellStart;
+    std::vector<uint32_t> m_fill;
+    std::vector<uint32_t> m_sorted;
+};
+
+// Hook run after each monitor sample, with both engines updated (e.g. TwoTierGraphAnalytics)
+typedef Callback<void, ConnectivityEngine *, ConnectivityEngine *> ConnectivitySampleCallback;
+
+// Leader pairs within backhaul range plus subordinate attachment on the access tier
+void MonitorSecondLevelClusterConnectivity(ConnectivityEngine *leaderGrid, ConnectivityEngine *accessGrid)
+{
+    globalConnectivity.totalChecks++;
+    leaderGrid->Update();
+    uint32_t totalPairs = leaderGrid->GetN() * (leaderGrid->GetN() - 1) / 2;
+    uint32_t connectedPairs = leaderGrid->ForEachLink([](uint32_t i, uint32_t j) {
+        globalConnectivity.pairConnectivity[PairKey(i, j)]++;
+    });
+    if (totalPairs>0 && (double)connectedPairs/totalPairs >= 0.5) globalConnectivity.connectedChecks++;
+
+    if (accessGrid) {
+        accessGrid->Update();
+        uint32_t members = 0;
+        globalConnectivity.attachedSamples += accessGrid->CountAttached(members);
+        globalConnectivity.subordinateSamples += members;
+        globalConnectivity.accessLinkSamples += accessGrid->ForEachLink([](uint32_t, uint32_t) {});
+    }
+}
+
+// Self-rescheduling tick: a single pending event instead of simTime/interval events up front.
+// The chain stops short of totalTime; a tick landing exactly on totalTime is scheduled before
+// Simulator::Stop (see ScheduleConnectivityMonitoring), otherwise the stop event, inserted
+// earlier with the same timestamp, would run first and drop the final sample
+void ConnectivityMonitorTick(ConnectivityEngine *leaderGrid, ConnectivityEngine *accessGrid, double interval, double totalTime,
+                             ConnectivitySampleCallback onSample, bool reschedule)
+{
+    MonitorSecondLevelClusterConnectivity(leaderGrid, accessGrid);
+    if (!onSample.IsNull() && accessGrid) onSample(leaderGrid, accessGrid);
+    if (reschedule && Simulator::Now().GetSeconds() + interval < totalTime - 1e-9) {
+        Simulator::Schedule(Seconds(interval), &ConnectivityMonitorTick, leaderGrid, accessGrid, interval, totalTime, onSample, true);
+    }
+}
+
+// Must be called before Simulator::Stop(Seconds(totalTime))
+void ScheduleConnectivityMonitoring(ConnectivityEngine *leaderGrid, ConnectivityEngine *accessGrid, double interval, double totalTime,
+                                    ConnectivitySampleCallback onSample = ConnectivitySampleCallback())
+{
+    Simulator::Schedule(Seconds(0.0), &ConnectivityMonitorTick, leaderGrid, accessGrid, interval, totalTime, onSample, true);
+    double ticks = std::round(totalTime / interval);
+    if (totalTime > 1e-9 && std::fabs(ticks * interval - totalTime) < 1e-9) {
+        Simulator::Schedule(Seconds(totalTime), &ConnectivityMonitorTick, leaderGrid, accessGrid, interval, totalTime, onSample, false);
+    }
+}
+
+// ----- Event-driven link tracker -----
+// Leader motion is piecewise linear, so for each pair the distance is a quadratic in time
+// between breakpoints and the next crossing of maxRange can be solved exactly. Each pair
+// keeps at most one pending event: either its next crossing or, when none is found within
+// the lookahead window, a re-check at the end of that window.
+class LinkEventTracker
+{
+public:
+    LinkEventTracker(const NodeContainer &nodes, double range, double horizon, double lookahead = 120.0, double histBin = 5.0, uint32_t histBins = 24)
+        : m_range(range), m_horizon(horizon), m_lookahead(lookahead), m_histBin(histBin),
+          m_histogram(histBins + 1, 0), m_transitions(0), m_censored(0), m_lifetimeSum(0.0),
+          m_components(0), m_partitionedTime(0.0)
+    {
+        for (uint32_t i=0;i<nodes.GetN();++i) m_mobility.push_back(nodes.Get(i)->GetObject<MobilityModel>());
+        uint32_t n = m_mobility.size();
+        m_pairs.resize(n > 1 ? n*(n-1)/2 : 0);
+    }
+
+    // Link up/down notifications (i < j, true when the link comes up)
+    void SetLinkChangeCallback(Callback<void, uint32_t, uint32_t, bool> cb) { m_linkChange = cb; }
+
+    void Start()
+    {
+        Time now = Simulator::Now();
+        uint32_t n = m_mobility.size();
+        for (uint32_t i=0;i<n;++i) {
+            for (uint32_t j=i+1;j<n;++j) {
+                PairState &ps = m_pairs[Index(i, j)];
+                Vector pi, vi, pj, vj; Time ei, ej;
+                GetMotion(i, now, pi, vi, ei);
+                GetMotion(j, now, pj, vj, ej);
+                ps.up = CalculateDistance(pi, pj) <= m_range;
+                ps.upSince = now;
+                if (ps.up) AddUpLink(i, j);
+                SchedulePair(i, j);
+            }
+        }
+        m_components = CountComponents();
+        m_partitionStart = now;
+        m_lastChange = now;
+    }
+
+    // Close open link and partition intervals at Now(); call before Simulator::Destroy()
+    void Finalize()
+    {
+        Time now = Simulator::Now();
+        AccountPartition(now);
+        if (m_components > 1) m_partitions.push_back({m_partitionStart.GetSeconds(), now.GetSeconds()});
+        uint32_t n = m_mobility.size();
+        for (uint32_t i=0;i<n;++i) {
+            for (uint32_t j=i+1;j<n;++j) {
+                PairState &ps = m_pairs[Index(i, j)];
+                ps.next.Cancel();
+                if (ps.up) {
+                    ps.totalUp += now - ps.upSince;
+                    m_censored++;
+                }
+            }
+        }
+    }
+
+    void Print(std::ostream &os, double totalTime) const
+    {
+        uint64_t completed = 0;
+        for (uint64_t c : m_histogram) completed += c;
+        double upSum = 0.0;
+        for (const PairState &ps : m_pairs) upSum += ps.totalUp.GetSeconds();
+        os << "Enlaces líder-líder (eventos): transiciones: " << m_transitions
+           << "  vidas completas: " << completed << " (abiertas al final: " << m_censored << ")"
+           << "  vida media(s): " << (completed > 0 ? m_lifetimeSum / completed : 0.0)
+           << "  tiempo medio enlazado por par: " << (m_pairs.empty() || totalTime <= 0 ? 0.0 : upSum / m_pairs.size() / totalTime * 100.0) << "%\n";
+        os << "  Histograma de vida (s):";
+        for (uint32_t b=0;b<m_histogram.size();++b) {
+            if (m_histogram[b] == 0) continue;
+            if (b + 1 == m_histogram.size()) os << " [>=" << b*m_histBin << "]:" << m_histogram[b];
+            else os << " [" << b*m_histBin << "," << (b+1)*m_histBin << "):" << m_histogram[b];
+        }
+        os << "\n  Particiones: intervalos: " << m_partitions.size() << "  tiempo particionado(s): " << m_partitionedTime << "\n";
+        for (const auto &iv : m_partitions) {
+            os << "    [" << iv.first << ", " << iv.second << ")\n";
+        }
+    }
+
+    uint64_t GetTransitions() const { return m_transitions; }
+    double GetPartitionedTime() const { return m_partitionedTime; }
+    bool IsUp(uint32_t i, uint32_t j) const { return i != j && m_pairs[i < j ? Index(i, j) : Index(j, i)].up; }
+
+private:
+    struct PairState {
+        bool up = false;
+        Time upSince;
+        Time totalUp;
+        EventId next;
+    };
+
+    uint32_t Index(uint32_t i, uint32_t j) const
+    {
+        uint32_t n = m_mobility.size();
+        return i*(2*n - i - 1)/2 + (j - i - 1);
+    }
+
+    void GetMotion(uint32_t i, Time t, Vector &p, Vector &v, Time &end) const
+    {
+        const PiecewiseLinearMotion *pl = dynamic_cast<const PiecewiseLinearMotion*>(PeekPointer(m_mobility[i]));
+        if (pl) {
+            pl->GetSegment(t, p, v, end);
+            return;
+        }
+        // Not piecewise linear: extrapolate from Now() and re-check every second
+        Time now = Simulator::Now();
+        v = m_mobility[i]->GetVelocity();
+        Vector p0 = m_mobility[i]->GetPosition();
+        double dt = (t - now).GetSeconds();
+        p = Vector(p0.x + v.x*dt, p0.y + v.y*dt, p0.z + v.z*dt);
+        end = now + Seconds(1.0);
+    }
+
+    // Walk the merged breakpoints of both nodes from Now() and return the first time the
+    // pair changes state; returns false if nothing happens before the lookahead window.
+    bool NextCrossing(uint32_t i, uint32_t j, bool up, Time &when) const
+    {
+        Time t = Simulator::Now();
+        Time limit = std::min(t + Seconds(m_lookahead), Seconds(m_horizon));
+        while (t < limit) {
+            Vector pi, vi, pj, vj; Time ei, ej;
+            GetMotion(i, t, pi, vi, ei);
+            GetMotion(j, t, pj, vj, ej);
+            Time end = std::min(std::min(ei, ej), limit);
+            double dx = pj.x - pi.x, dy = pj.y - pi.y, dz = pj.z - pi.z;
+            double wx = vj.x - vi.x, wy = vj.y - vi.y, wz = vj.z - vi.z;
+            double a = wx*wx + wy*wy + wz*wz;
+            double b = 2.0*(dx*wx + dy*wy + dz*wz);
+            double c = dx*dx + dy*dy + dz*dz - m_range*m_range;
+            double disc = b*b - 4*a*c;
+            if (a > 0.0 && disc >= 0.0) {
+                // In range: leave at the larger root. Out of range: enter at the smaller one.
+                double sq = std::sqrt(disc);
+                double tau = up ? (-b + sq) / (2*a) : (-b - sq) / (2*a);
+                double span = (end - t).GetSeconds();
+                if (tau > 1e-9 && tau <= span) {
+                    when = t + Seconds(tau);
+                    return true;
+                }
+            }
+            if (end <= t) break;
+            t = end;
+        }
+        when = limit;
+        return false;
+    }
+
+    void SchedulePair(uint32_t i, uint32_t j)
+    {
+        PairState &ps = m_pairs[Index(i, j)];
+        Time when;
+        bool crossing = NextCrossing(i, j, ps.up, when);
+        if (when >= Seconds(m_horizon) && !crossing) return;
+        Time delay = std::max(when - Simulator::Now(), NanoSeconds(1));
+        ps.next = Simulator::Schedule(delay, &LinkEventTracker::OnPairEvent, this, i, j, crossing);
+    }
+
+    void OnPairEvent(uint32_t i, uint32_t j, bool crossing)
+    {
+        if (crossing) {
+            PairState &ps = m_pairs[Index(i, j)];
+            Time now = Simulator::Now();
+            m_transitions++;
+            if (ps.up) {
+                double life = (now - ps.upSince).GetSeconds();
+                ps.totalUp += now - ps.upSince;
+                m_lifetimeSum += life;
+                uint32_t b = std::min<uint32_t>((uint32_t)(life / m_histBin), m_histogram.size() - 1);
+                m_histogram[b]++;
+                RemoveUpLink(i, j);
+            } else {
+                ps.upSince = now;
+                AddUpLink(i, j);
+            }
+            ps.up = !ps.up;
+            UpdatePartitions(now);
+            if (!m_linkChange.IsNull()) m_linkChange(i, j, ps.up);
+        }
+        SchedulePair(i, j);
+    }
+
+    void AddUpLink(uint32_t i, uint32_t j)
+    {
+        m_upIndex[PairKey(i, j)] = m_upLinks.size();
+        m_upLinks.push_back(PairKey(i, j));
+    }
+
+    void RemoveUpLink(uint32_t i, uint32_t j)
+    {
+        auto it = m_upIndex.find(PairKey(i, j));
+        if (it == m_upIndex.end()) return;
+        size_t pos = it->second;
+        m_upIndex.erase(it);
+        if (pos + 1 != m_upLinks.size()) {
+            m_upLinks[pos] = m_upLinks.back();
+            m_upIndex[m_upLinks[pos]] = pos;
+        }
+        m_upLinks.pop_back();
+    }
+
+    // Union-find over the current up links: O(n + links) per transition
+    uint32_t CountComponents()
+    {
+        uint32_t n = m_mobility.size();
+        m_parent.resize(n);
+        for (uint32_t i=0;i<n;++i) m_parent[i] = i;
+        uint32_t components = n;
+        for (uint64_t key : m_upLinks) {
+            uint32_t a = Find(key >> 32), b = Find(key & 0xffffffff);
+            if (a != b) { m_parent[a] = b; components--; }
+        }
+        return components;
+    }
+
+    uint32_t Find(uint32_t x)
+    {
+        while (m_parent[x] != x) { m_parent[x] = m_parent[m_parent[x]]; x = m_parent[x]; }
+        return x;
+    }
+
+    void AccountPartition(Time now)
+    {
+        if (m_components > 1) m_partitionedTime += (now - m_lastChange).GetSeconds();
+        m_lastChange = now;
+    }
+
+    void UpdatePartitions(Time now)
+    {
+        AccountPartition(now);
+        uint32_t before = m_components;
+        m_components = CountComponents();
+        if (before <= 1 && m_components > 1) m_partitionStart = now;
+        if (before > 1 && m_components <= 1) {
+            m_partitions.push_back({m_partitionStart.GetSeconds(), now.GetSeconds()});
+        }
+    }
+
+    std::vector<Ptr<MobilityModel>> m_mobility;
+    std::vector<PairState> m_pairs;     // triangular index, see Index()
+    std::vector<uint64_t> m_upLinks;    // PairKey of links currently up
+    std::unordered_map<uint64_t, size_t> m_upIndex;
+    std::vector<uint32_t> m_parent;
+    Callback<void, uint32_t, uint32_t, bool> m_linkChange;
+    double m_range;
+    double m_horizon;
+    double m_lookahead;
+    double m_histBin;
+    std::vector<uint64_t> m_histogram;
+    uint64_t m_transitions;
+    uint64_t m_censored;
+    double m_lifetimeSum;
+    uint32_t m_components;
+    Time m_partitionStart;
+    Time m_lastChange;
+    double m_partitionedTime;
+    std::vector<std::pair<double, double>> m_partitions;
+};
+
+// Subordinate mobility: leader-relative group model (leader position + bounded random-walk offset)
+void SetupSubordinateMobility(NodeContainer &subs, Ptr<Node> leader, double radius, double speed)
+{
+    Ptr<MobilityModel> lm = leader->GetObject<MobilityModel>();
+    Ptr<UniformRandomVariable> ur = CreateObject<UniformRandomVariable>();
+    for (uint32_t i=0;i<subs.GetN();++i) {
+        Ptr<GroupMemberMobilityModel> model = CreateObject<GroupMemberMobilityModel>();
+        model->SetAttribute("Radius", DoubleValue(radius*0.8));
+        model->SetAttribute("Speed", DoubleValue(speed));
+        model->SetAttribute("StepDistance", DoubleValue(radius*0.2));
+        model->SetReference(lm, Vector(ur->GetValue(-radius*0.5, radius*0.5), ur->GetValue(-radius*0.5, radius*0.5), 0));
+        subs.Get(i)->AggregateObject(model);
+    }
+    NS_LOG_INFO("SetupSubordinateMobility: " << subs.GetN() << " subordinados (radio=" << radius << ", speed=" << speed << ")");
+}
+
+// ----- Binary mobility trace: recording and mmap replay -----
+// Layout (host byte order, 8-byte aligned):
+//   header   "MJMB" u32 version, u32 nodes, u32 reserved, f64 duration
+//   index    nodes x {u64 first, u64 count}             indexed by node id
+//   segments {f64 t, x, y, z, vx, vy, vz}               sorted by t within each node
+// Position at time t is p + v*(t - t0) of the last segment with t0 <= t.
+static const uint32_t kMobilityTraceVersion = 1;
+
+struct MobilitySegment {
+    double t, x, y, z, vx, vy, vz;
+};
+
+// Walks every node's piecewise-linear motion from Now() to `duration` and writes all segments.
+// Call before Simulator::Run(): models that draw their path lazily draw it here, once.
+void RecordMobilityTrace(const NodeContainer &nodes, double duration, const std::string &path)
+{
+    uint32_t maxId = 0;
+    for (uint32_t i=0;i<nodes.GetN();++i) maxId = std::max(maxId, nodes.Get(i)->GetId());
+    uint32_t count = nodes.GetN() > 0 ? maxId + 1 : 0;
+    std::vector<std::vector<MobilitySegment>> perNode(count);
+    Time stop = Seconds(duration);
+    uint64_t total = 0;
+    for (uint32_t i=0;i<nodes.GetN();++i) {
+        Ptr<MobilityModel> m = nodes.Get(i)->GetObject<MobilityModel>();
+        if (!m) continue;
+        std::vector<MobilitySegment> &segs = perNode[nodes.Get(i)->GetId()];
+        const PiecewiseLinearMotion *pl = dynamic_cast<const PiecewiseLinearMotion*>(PeekPointer(m));
+        Time t = Simulator::Now();
+        while (true) {
+            Vector p, v;
+            Time end = Time::Max();
+            if (pl) pl->GetSegment(t, p, v, end);
+            else { p = m->GetPosition(); v = Vector(0, 0, 0); }
+            segs.push_back({t.GetSeconds(), p.x, p.y, p.z, v.x, v.y, v.z});
+            if (end >= stop || end <= t) break;
+            t = end;
+        }
+        total += segs.size();
+    }
+
+    std::ofstream os(path.c_str(), std::ios::binary);
+    uint32_t reserved = 0;
+    os.write("MJMB", 4);
+    os.write(reinterpret_cast<const char*>(&kMobilityTraceVersion), 4);
+    os.write(reinterpret_cast<const char*>(&count), 4);
+    os.write(reinterpret_cast<const char*>(&reserved), 4);
+    os.write(reinterpret_cast<const char*>(&duration), 8);
+    uint64_t first = 0;
+    for (uint32_t n=0;n<count;++n) {
+        uint64_t c = perNode[n].size();
+        os.write(reinterpret_cast<const char*>(&first), 8);
+        os.write(reinterpret_cast<const char*>(&c), 8);
+        first += c;
+    }
+    for (const std::vector<MobilitySegment> &segs : perNode) {
+        os.write(reinterpret_cast<const char*>(segs.data()), segs.size() * sizeof(MobilitySegment));
+    }
+    NS_ABORT_MSG_IF(!os, "No se puede escribir la traza de movilidad: " << path);
+    NS_LOG_INFO("Traza de movilidad: " << total << " segmentos de " << nodes.GetN() << " nodos en " << path);
+}
+
+// Read-only mapping of a recorded trace, shared by every replay model (and, through the page
+// cache, by parallel runs replaying the same file)
+class MobilityTraceFile
+{
+public:
+    explicit MobilityTraceFile(const std::string &path) : m_base(nullptr), m_size(0)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        NS_ABORT_MSG_IF(fd < 0, "No se puede abrir la traza de movilidad: " << path);
+        struct stat st;
+        bool statOk = fstat(fd, &st) == 0;
+        m_size = statOk ? st.st_size : 0;
+        void *p = m_size >= 24 ? mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        close(fd);
+        NS_ABORT_MSG_IF(!statOk || m_size < 24, "Traza de movilidad no válida: " << path);
+        NS_ABORT_MSG_IF(p == MAP_FAILED, "mmap falló: " << path);
+        m_base = static_cast<const char*>(p);
+        uint32_t version;
+        std::memcpy(&version, m_base + 4, 4);
+        NS_ABORT_MSG_IF(std::memcmp(m_base, "MJMB", 4) != 0 || version != kMobilityTraceVersion,
+                        "Traza de movilidad no válida: " << path);
+        std::memcpy(&m_nodes, m_base + 8, 4);
+        std::memcpy(&m_duration, m_base + 16, 8);
+        // Index and every indexed segment range must lie inside the mapping, checked once here
+        // so replay never reads past the end of a truncated or foreign file
+        NS_ABORT_MSG_IF(m_nodes > (m_size - 24) / 16, "Traza de movilidad no válida (índice truncado): " << path);
+        size_t segmentBytes = m_size - 24 - 16ull*m_nodes;
+        NS_ABORT_MSG_IF(segmentBytes % sizeof(MobilitySegment) != 0, "Traza de movilidad no válida (segmentos truncados): " << path);
+        uint64_t total = segmentBytes / sizeof(MobilitySegment);
+        m_index = reinterpret_cast<const uint64_t*>(m_base + 24);
+        m_segments = reinterpret_cast<const MobilitySegment*>(m_base + 24 + 16ull*m_nodes);
+        for (uint32_t n=0;n<m_nodes;++n) {
+            uint64_t first = m_index[2*n], count = m_index[2*n + 1];
+            NS_ABORT_MSG_IF(count > total || first > total - count,
+                            "Traza de movilidad no válida (nodo " << n << " fuera de rango): " << path);
+        }
+    }
+
+    ~MobilityTraceFile() { if (m_base) munmap(const_cast<char*>(m_base), m_size); }
+
+    uint32_t GetNNodes() const { return m_nodes; }
+    double GetDuration() const { return m_duration; }
+
+    const MobilitySegment *GetSegments(uint32_t nodeId, uint64_t &count) const
+    {
+        count = nodeId < m_nodes ? m_index[2*nodeId + 1] : 0;
+        return count > 0 ? m_segments + m_index[2*nodeId] : nullptr;
+    }
+
+private:
+    const char *m_base;
+    size_t m_size;
+    uint32_t m_nodes;
+    double m_duration;
+    const uint64_t *m_index;
+    const MobilitySegment *m_segments;
+};
+
+// Mobility read from a MobilityTraceFile: binary search over the node's segments (with the
+// previous hit tried first), no events and no course-change notifications
+class TraceReplayMobilityModel : public MobilityModel, public PiecewiseLinearMotion
+{
+public:
+    static TypeId GetTypeId()
+    {
+        static TypeId tid = TypeId("TraceReplayMobilityModel")
+            .SetParent<MobilityModel>()
+            .SetGroupName("Mobility")
+            .AddConstructor<TraceReplayMobilityModel>();
+        return tid;
+    }
+
+    TraceReplayMobilityModel() : m_segs(nullptr), m_count(0), m_hint(0), m_offset(0, 0, 0) {}
+
+    void SetTrace(std::shared_ptr<const MobilityTraceFile> trace, uint32_t nodeId)
+    {
+        m_trace = trace;
+        m_segs = trace->GetSegments(nodeId, m_count);
+        m_hint = 0;
+    }
+
+    virtual Ptr<MobilityModel> Copy() const override
+    {
+        Ptr<TraceReplayMobilityModel> copy = CreateObject<TraceReplayMobilityModel>();
+        copy->m_trace = m_trace;
+        copy->m_segs = m_segs;
+        copy->m_count = m_count;
+        copy->m_offset = m_offset;
+        return copy;
+    }
+
+    virtual void GetSegment(Time t, Vector &position, Vector &velocity, Time &segmentEnd) const override
+    {
+        if (m_count == 0) {
+            position = m_offset; velocity = Vector(0, 0, 0); segmentEnd = Time::Max();
+            return;
+        }
+        uint64_t k = Locate(t.GetSeconds());
+        const MobilitySegment &s = m_segs[k];
+        double dt = std::max(0.0, t.GetSeconds() - s.t);
+        position = Vector(s.x + s.vx*dt + m_offset.x, s.y + s.vy*dt + m_offset.y, s.z + s.vz*dt + m_offset.z);
+        velocity = Vector(s.vx, s.vy, s.vz);
+        segmentEnd = k + 1 < m_count ? Seconds(m_segs[k+1].t) : Time::Max();
+    }
+
+private:
+    uint64_t Locate(double t) const
+    {
+        if (m_hint < m_count && m_segs[m_hint].t <= t && (m_hint + 1 == m_count || t < m_segs[m_hint+1].t)) return m_hint;
+        const MobilitySegment *it = std::upper_bound(m_segs, m_segs + m_count, t,
+                                                     [](double v, const MobilitySegment &s) { return v < s.t; });
+        m_hint = it == m_segs ? 0 : (it - m_segs) - 1;
+        return m_hint;
+    }
+
+    virtual Vector DoGetPosition() const override
+    {
+        Vector p, v; Time end;
+        GetSegment(Simulator::Now(), p, v, end);
+        return p;
+    }
+
+    virtual Vector DoGetVelocity() const override
+    {
+        Vector p, v; Time end;
+        GetSegment(Simulator::Now(), p, v, end);
+        return v;
+    }
+
+    // Translate the recorded path so the node is at `position` now
+    virtual void DoSetPosition(const Vector &position) override
+    {
+        Vector current = DoGetPosition();
+        m_offset = Vector(m_offset.x + position.x - current.x, m_offset.y + position.y - current.y, m_offset.z + position.z - current.z);
+        NotifyCourseChange();
+    }
+
+    virtual int64_t DoAssignStreams(int64_t) override { return 0; }
+
+    std::shared_ptr<const MobilityTraceFile> m_trace;
+    const MobilitySegment *m_segs;
+    uint64_t m_count;
+    mutable uint64_t m_hint;
+    Vector m_offset;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(TraceReplayMobilityModel);
+
+// Replaces the generated mobility: every node follows its recorded segments
+void SetupReplayMobility(const NodeContainer &nodes, const std::string &path)
+{
+    std::shared_ptr<const MobilityTraceFile> trace = std::make_shared<MobilityTraceFile>(path);
+    for (uint32_t i=0;i<nodes.GetN();++i) {
+        uint32_t id = nodes.Get(i)->GetId();
+        NS_ABORT_MSG_IF(id >= trace->GetNNodes(), "La traza de movilidad no contiene el nodo " << id << " (¿mismo escenario?)");
+        Ptr<TraceReplayMobilityModel> model = CreateObject<TraceReplayMobilityModel>();
+        model->SetTrace(trace, id);
+        nodes.Get(i)->AggregateObject(model);
+    }
+    NS_LOG_INFO("SetupReplayMobility: " << nodes.GetN() << " nodos desde " << path << " (" << trace->GetDuration() << " s)");
+}
+
+// Endpoints of one traffic-matrix flow (see ResolveTrafficEndpoints)
+struct TrafficFlow {
+    uint32_t srcCluster;
+    uint32_t dstCluster;
+    Ptr<Node> src;
+    Ptr<Node> dst;
+    Ipv4Address dstAddress;
+};
+
+// Inter-cluster traffic: one OnOff source per flow and a single PacketSink per destination
+// node, all on the same port (flows are told apart by their source address)
+void SetupInterClusterTraffic(const std::vector<TrafficFlow> &flows, const std::string &rate, double startTime, double stopTime)
+{
+    uint16_t port = 9000;
+    std::set<uint32_t> hasSink;
+    for (const TrafficFlow &f : flows) {
+        OnOffHelper on("ns3::UdpSocketFactory", InetSocketAddress(f.dstAddress, port));
+        on.SetConstantRate(DataRate(rate));
+        on.SetAttribute("PacketSize", UintegerValue(512));
+        ApplicationContainer apps = on.Install(f.src);
+        apps.Start(Seconds(startTime + (f.srcCluster % 10)*0.5));
+        apps.Stop(Seconds(stopTime));
+        if (hasSink.insert(f.dst->GetId()).second) {
+            PacketSinkHelper sink("ns3::UdpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), port));
+            apps = sink.Install(f.dst);
+            apps.Start(Seconds(startTime));
+            apps.Stop(Seconds(stopTime));
+        }
+    }
+    NS_LOG_INFO("SetupInterClusterTraffic: " << flows.size() << " flujos OnOff configurados");
+}
+
+// ----- Traffic engine: multi-flow sources and multiplexed sinks -----
+// One MultiFlowSource per sending node (a single UDP socket and a single pending event for all
+// its flows, kept in a min-heap by next transmission time) and one MultiFlowSink per receiving
+// node on port 9000, so the application/socket count grows with nodes, not with flows.
+// Profiles: cbr (constant gap), poisson (exponential gaps), bursty (exponential ON/OFF periods,
+// peak rate scaled so the mean equals the flow rate) and saturating (back-to-back at line rate).
+class MultiFlowSource : public Application
+{
+public:
+    enum Profile { CBR, POISSON, BURSTY, SATURATING };
+
+    static TypeId GetTypeId()
+    {
+        static TypeId tid = TypeId("MultiFlowSource")
+            .SetParent<Application>()
+            .SetGroupName("Applications")
+            .AddConstructor<MultiFlowSource>()
+            .AddAttribute("PacketSize", "UDP payload size (bytes)",
+                          UintegerValue(512), MakeUintegerAccessor(&MultiFlowSource::m_packetSize), MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("MeanOnTime", "Bursty profile: mean ON period (s)",
+                          DoubleValue(0.5), MakeDoubleAccessor(&MultiFlowSource::m_meanOn), MakeDoubleChecker<double>(1e-6))
+            .AddAttribute("MeanOffTime", "Bursty profile: mean OFF period (s)",
+                          DoubleValue(0.5), MakeDoubleAccessor(&MultiFlowSource::m_meanOff), MakeDoubleChecker<double>(0.0));
+        return tid;
+    }
+
+    MultiFlowSource() : m_packetSize(512), m_meanOn(0.5), m_meanOff(0.5), m_profile(CBR), m_sent(0)
+    {
+        m_exp = CreateObject<ExponentialRandomVariable>();
+    }
+
+    void SetProfile(Profile p) { m_profile = p; }
+
+    // rateBps: mean offered load of the flow (the line rate for SATURATING)
+    void AddFlow(const Address &dst, double rateBps, double start, double stop)
+    {
+        Flow f;
+        f.dst = dst;
+        f.rate = std::max(rateBps, 1.0);
+        f.start = start;
+        f.stop = stop;
+        m_flows.push_back(f);
+    }
+
+    int64_t AssignStreams(int64_t stream)
+    {
+        m_exp->SetStream(stream);
+        return 1;
+    }
+
+    uint64_t GetSent() const { return m_sent; }
+
+protected:
+    virtual void DoDispose() override
+    {
+        m_socket = nullptr;
+        Application::DoDispose();
+    }
+
+private:
+    struct Flow {
+        Address dst;
+        double rate = 0.0, start = 0.0, stop = 0.0;
+        double onUntil = 0.0;
+    };
+    typedef std::pair<double, uint32_t> Pending; // (next tx time, flow index)
+
+    virtual void StartApplication() override
+    {
+        m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+        m_socket->Bind();
+        double now = Simulator::Now().GetSeconds();
+        for (uint32_t k=0;k<m_flows.size();++k) {
+            Flow &f = m_flows[k];
+            double t = std::max(f.start, now);
+            if (m_profile == BURSTY) f.onUntil = t + m_exp->GetValue(m_meanOn, 0);
+            if (m_profile == POISSON) t += m_exp->GetValue(Gap(f), 0);
+            if (t < f.stop) m_pending.push(Pending(t, k));
+        }
+        ScheduleNext();
+    }
+
+    virtual void StopApplication() override
+    {
+        Simulator::Cancel(m_event);
+        m_pending = std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>>();
+        if (m_socket) m_socket->Close();
+    }
+
+    double Gap(const Flow &f) const { return m_packetSize * 8.0 / f.rate; }
+
+    void ScheduleNext()
+    {
+        if (m_pending.empty()) return;
+        double delay = std::max(0.0, m_pending.top().first - Simulator::Now().GetSeconds());
+        m_event = Simulator::Schedule(Seconds(delay), &MultiFlowSource::Send, this);
+    }
+
+    void Send()
+    {
+        double now = Simulator::Now().GetSeconds();
+        uint32_t k = m_pending.top().second;
+        m_pending.pop();
+        Flow &f = m_flows[k];
+        m_socket->SendTo(Create<Packet>(m_packetSize), 0, f.dst);
+        m_sent++;
+
+        double next;
+        switch (m_profile) {
+        case POISSON:
+            next = now + m_exp->GetValue(Gap(f), 0);
+            break;
+        case BURSTY: {
+            // Peak rate (on+off)/on times the mean keeps the long-run load at f.rate
+            double peakGap = Gap(f) * m_meanOn / (m_meanOn + m_meanOff);
+            next = now + peakGap;
+            if (next > f.onUntil) {
+                next = f.onUntil + (m_meanOff > 0 ? m_exp->GetValue(m_meanOff, 0) : 0.0);
+                f.onUntil = next + m_exp->GetValue(m_meanOn, 0);
+            }
+            break;
+        }
+        default: // CBR, SATURATING
+            next = now + Gap(f);
+        }
+        if (next < f.stop) m_pending.push(Pending(next, k));
+        ScheduleNext();
+    }
+
+    uint32_t m_packetSize;
+    double m_meanOn;
+    double m_meanOff;
+    Profile m_profile;
+    std::vector<Flow> m_flows;
+    std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>> m_pending;
+    Ptr<Socket> m_socket;
+    Ptr<ExponentialRandomVariable> m_exp;
+    EventId m_event;
+    uint64_t m_sent;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(MultiFlowSource);
+
+// Single UDP socket per receiving node for every flow addressed to it
+class MultiFlowSink : public Application
+{
+public:
+    static TypeId GetTypeId()
+    {
+        static TypeId tid = TypeId("MultiFlowSink")
+            .SetParent<Application>()
+            .SetGroupName("Applications")
+            .AddConstructor<MultiFlowSink>()
+            .AddAttribute("Port", "UDP port",
+                          UintegerValue(9000), MakeUintegerAccessor(&MultiFlowSink::m_port), MakeUintegerChecker<uint16_t>());
+        return tid;
+    }
+
+    MultiFlowSink() : m_port(9000), m_rxPackets(0), m_rxBytes(0) {}
+
+    uint64_t GetRxPackets() const { return m_rxPackets; }
+    uint64_t GetRxBytes() const { return m_rxBytes; }
+
+protected:
+    virtual void DoDispose() override
+    {
+        m_socket = nullptr;
+        Application::DoDispose();
+    }
+
+private:
+    virtual void StartApplication() override
+    {
+        m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+        m_socket->Bind(InetSocketAddress(Ipv4Address::GetAny(), m_port));
+        m_socket->SetRecvCallback(MakeCallback(&MultiFlowSink::HandleRead, this));
+    }
+
+    virtual void StopApplication() override
+    {
+        if (m_socket) m_socket->Close();
+    }
+
+    void HandleRead(Ptr<Socket> socket)
+    {
+        Address from;
+        while (Ptr<Packet> p = socket->RecvFrom(from)) {
+            m_rxPackets++;
+            m_rxBytes += p->GetSize();
+        }
+    }
+
+    uint16_t m_port;
+    Ptr<Socket> m_socket;
+    uint64_t m_rxPackets;
+    uint64_t m_rxBytes;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(MultiFlowSink);
+
+// Maps cluster pairs of the traffic matrix to endpoints: "leader" (backhaul addresses, as the
+// OnOff setup), "subordinate" (round-robin over each cluster's subordinates, falling back to
+// the leader in empty clusters) or "mixed" (flow k cycles through sub->sub, sub->leader,
+// leader->sub and leader->leader)
+static std::vector<TrafficFlow>
+ResolveTrafficEndpoints(const std::vector<std::pair<uint32_t, uint32_t>> &flows, NodeContainer &leaders,
+                        Ipv4InterfaceContainer &leaderBackhaulIfaces, const std::vector<NodeContainer> &clusterSubs,
+                        const std::vector<Ipv4InterfaceContainer> &ifacesPerCluster, const std::string &mode)
+{
+    std::vector<uint32_t> nextSub(leaders.GetN(), 0);
+    auto pick = [&] (uint32_t cluster, bool subordinate, Ptr<Node> &node, Ipv4Address &addr) {
+        if (subordinate && cluster < clusterSubs.size() && clusterSubs[cluster].GetN() > 0) {
+            uint32_t j = nextSub[cluster]++ % clusterSubs[cluster].GetN();
+            node = clusterSubs[cluster].Get(j);
+            addr = ifacesPerCluster[cluster].GetAddress(j + 1); // address 0 is the leader's access interface
+        } else {
+            node = leaders.Get(cluster);
+            addr = leaderBackhaulIfaces.GetAddress(cluster);
+        }
+    };
+    NS_ABORT_MSG_IF(mode != "leader" && mode != "subordinate" && mode != "mixed", "Extremos de tráfico desconocidos: " << mode);
+    std::vector<TrafficFlow> out;
+    for (uint32_t k=0;k<flows.size();++k) {
+        bool srcSub = mode == "subordinate" || (mode == "mixed" && k % 4 < 2);
+        bool dstSub = mode == "subordinate" || (mode == "mixed" && k % 2 == 0);
+        TrafficFlow f;
+        f.srcCluster = flows[k].first;
+        f.dstCluster = flows[k].second;
+        Ipv4Address unused;
+        pick(f.srcCluster, srcSub, f.src, unused);
+        pick(f.dstCluster, dstSub, f.dst, f.dstAddress);
+        out.push_back(f);
+    }
+    return out;
+}
+
+// Installs one MultiFlowSource per source node and one MultiFlowSink per destination node.
+// Returns the offered load in kbps (mean rate for cbr/poisson/bursty, line rate when saturating).
+static double
+InstallTrafficEngine(const std::vector<TrafficFlow> &flows, const std::string &profile, double rateBps, double lineRateBps,
+                     double burstOn, double burstOff, double startTime, double stopTime)
+{
+    NS_ABORT_MSG_IF(profile != "cbr" && profile != "poisson" && profile != "bursty" && profile != "saturating",
+                    "Perfil de tráfico desconocido: " << profile);
+    MultiFlowSource::Profile p = profile == "poisson" ? MultiFlowSource::POISSON
+                               : profile == "bursty" ? MultiFlowSource::BURSTY
+                               : profile == "saturating" ? MultiFlowSource::SATURATING : MultiFlowSource::CBR;
+    double flowRate = p == MultiFlowSource::SATURATING ? lineRateBps : rateBps;
+    std::map<uint32_t, Ptr<MultiFlowSource>> sources;
+    std::set<uint32_t> sinks;
+    for (const TrafficFlow &f : flows) {
+        Ptr<MultiFlowSource> &src = sources[f.src->GetId()];
+        if (!src) {
+            src = CreateObject<MultiFlowSource>();
+            src->SetProfile(p);
+            src->SetAttribute("MeanOnTime", DoubleValue(burstOn));
+            src->SetAttribute("MeanOffTime", DoubleValue(burstOff));
+            f.src->AddApplication(src);
+            src->SetStartTime(Seconds(startTime));
+            src->SetStopTime(Seconds(stopTime));
+        }
+        // Same per-source stagger as the OnOff setup
+        src->AddFlow(InetSocketAddress(f.dstAddress, 9000), flowRate, startTime + (f.srcCluster % 10)*0.5, stopTime);
+        if (sinks.insert(f.dst->GetId()).second) {
+            Ptr<MultiFlowSink> sink = CreateObject<MultiFlowSink>();
+            f.dst->AddApplication(sink);
+            sink->SetStartTime(Seconds(startTime));
+            sink->SetStopTime(Seconds(stopTime));
+        }
+    }
+    NS_LOG_INFO("Motor de tráfico: " << flows.size() << " flujos (" << profile << "), " << sources.size()
+                << " fuentes y " << sinks.size() << " sumideros");
+    return flows.size() * flowRate / 1000.0;
+}
+
+// ----- Range-culled spectrum channel -----
+// Friis loss with a lazily filled table over quantized distances (bin centers), same formula
+// and minimum-loss clamp as FriisPropagationLossModel
+class CachedFriisPropagationLossModel : public PropagationLossModel
+{
+public:
+    static TypeId GetTypeId()
+    {
+        static TypeId tid = TypeId("CachedFriisPropagationLossModel")
+            .SetParent<PropagationLossModel>()
+            .SetGroupName("Propagation")
+            .AddConstructor<CachedFriisPropagationLossModel>()
+            .AddAttribute("Frequency", "Carrier frequency (Hz)",
+                          DoubleValue(5.15e9), MakeDoubleAccessor(&CachedFriisPropagationLossModel::m_frequency), MakeDoubleChecker<double>(1.0))
+            .AddAttribute("Quantum", "Distance bin width of the loss table (m)",
+                          DoubleValue(0.05), MakeDoubleAccessor(&CachedFriisPropagationLossModel::m_quantum), MakeDoubleChecker<double>(1e-6))
+            .AddAttribute("MaxDistance", "Distances beyond this are computed without the table (m)",
+                          DoubleValue(5000.0), MakeDoubleAccessor(&CachedFriisPropagationLossModel::m_maxDistance), MakeDoubleChecker<double>(0.0))
+            .AddAttribute("MinLoss", "Minimum loss (dB)",
+                          DoubleValue(0.0), MakeDoubleAccessor(&CachedFriisPropagationLossModel::m_minLoss), MakeDoubleChecker<double>(0.0));
+        return tid;
+    }
+
+    CachedFriisPropagationLossModel() : m_frequency(5.15e9), m_quantum(0.05), m_maxDistance(5000.0), m_minLoss(0.0) {}
+
+    double LossDb(double d) const
+    {
+        if (d <= 0) return m_minLoss;
+        double lambda = 299792458.0 / m_frequency;
+        return std::max(20.0 * std::log10(4.0 * M_PI * d / lambda), m_minLoss);
+    }
+
+    // Largest distance at which a txPowerDbm transmission still arrives at or above thresholdDbm
+    double RangeFor(double txPowerDbm, double thresholdDbm) const
+    {
+        double lambda = 299792458.0 / m_frequency;
+        return lambda / (4.0 * M_PI) * std::pow(10.0, (txPowerDbm - thresholdDbm) / 20.0);
+    }
+
+private:
+    virtual double DoCalcRxPower(double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const override
+    {
+        double d = a->GetDistanceFrom(b);
+        if (d >= m_maxDistance) return txPowerDbm - LossDb(d);
+        size_t bin = (size_t)(d / m_quantum);
+        if (bin >= m_table.size()) m_table.resize(bin + 1, std::numeric_limits<double>::quiet_NaN());
+        if (std::isnan(m_table[bin])) m_table[bin] = LossDb((bin + 0.5) * m_quantum);
+        return txPowerDbm - m_table[bin];
+    }
+
+    virtual int64_t DoAssignStreams(int64_t) override { return 0; }
+
+    double m_frequency;
+    double m_quantum;
+    double m_maxDistance;
+    double m_minLoss;
+    mutable std::vector<double> m_table;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(CachedFriisPropagationLossModel);
+
+// Drops receivers whose best-case power (MaxTxPower over free space) is below Threshold before the
+// channel computes loss or schedules a reception. Positions come from a ConnectivityEngine grid
+// refreshed every RefreshInterval; its radius is padded by the distance two nodes can close in
+// that time, so culling is conservative. The neighbor set is built once per transmission.
+class RangeCullFilter : public SpectrumTransmitFilter
+{
+public:
+    static TypeId GetTypeId()
+    {
+        static TypeId tid = TypeId("RangeCullFilter")
+            .SetParent<SpectrumTransmitFilter>()
+            .SetGroupName("Spectrum")
+            .AddConstructor<RangeCullFilter>()
+            .AddAttribute("MaxTxPower", "Highest transmit power on the channel (dBm)",
+                          DoubleValue(16.0206), MakeDoubleAccessor(&RangeCullFilter::m_maxTxPower), MakeDoubleChecker<double>())
+            .AddAttribute("Threshold", "Receivers below this best-case power are skipped (dBm)",
+                          DoubleValue(-101.0), MakeDoubleAccessor(&RangeCullFilter::m_threshold), MakeDoubleChecker<double>())
+            .AddAttribute("RefreshInterval", "Period of the position snapshot (s)",
+                          DoubleValue(0.1), MakeDoubleAccessor(&RangeCullFilter::m_refresh), MakeDoubleChecker<double>(0.0))
+            .AddAttribute("MaxSpeed", "Upper bound on node speed, pads the cull radius (m/s)",
+                          DoubleValue(0.0), MakeDoubleAccessor(&RangeCullFilter::m_maxSpeed), MakeDoubleChecker<double>(0.0));
+        return tid;
+    }
+
+    RangeCullFilter() : m_maxTxPower(16.0206), m_threshold(-101.0), m_refresh(0.1), m_maxSpeed(0.0),
+                        m_lastUpdate(-1.0), m_lastParams(nullptr), m_lastSender(0), m_lastTxTime(-1.0), m_stamp(0) {}
+
+    void Install(const NodeContainer &nodes, Ptr<CachedFriisPropagationLossModel> loss)
+    {
+        double radius = loss->RangeFor(m_maxTxPower, m_threshold) + 2.0 * m_maxSpeed * m_refresh;
+        m_engine.reset(new ConnectivityEngine(nodes, radius));
+        for (uint32_t i=0;i<nodes.GetN();++i) {
+            uint32_t id = nodes.Get(i)->GetId();
+            if (id >= m_index.size()) m_index.resize(id + 1, std::numeric_limits<uint32_t>::max());
+            m_index[id] = i;
+        }
+        m_mark.assign(nodes.GetN(), 0);
+    }
+
+    double GetRadius() const { return m_engine ? m_engine->GetRange() : 0.0; }
+
+private:
+    uint32_t IndexOf(Ptr<NetDevice> dev) const
+    {
+        if (!dev) return std::numeric_limits<uint32_t>::max();
+        uint32_t id = dev->GetNode()->GetId();
+        return id < m_index.size() ? m_index[id] : std::numeric_limits<uint32_t>::max();
+    }
+
+    virtual bool DoFilter(Ptr<const SpectrumSignalParameters> params, Ptr<const SpectrumPhy> receiverPhy) override
+    {
+        if (!m_engine || !params->txPhy) return false;
+        uint32_t s = IndexOf(params->txPhy->GetDevice()), r = IndexOf(receiverPhy->GetDevice());
+        if (s == std::numeric_limits<uint32_t>::max() || r == std::numeric_limits<uint32_t>::max()) return false;
+        double now = Simulator::Now().GetSeconds();
+        if (PeekPointer(params) != m_lastParams || s != m_lastSender || now != m_lastTxTime) {
+            if (m_lastUpdate < 0 || now - m_lastUpdate >= m_refresh) {
+                m_engine->Update();
+                m_lastUpdate = now;
+            }
+            m_lastParams = PeekPointer(params);
+            m_lastSender = s;
+            m_lastTxTime = now;
+            if (++m_stamp == 0) { std::fill(m_mark.begin(), m_mark.end(), 0); m_stamp = 1; }
+            m_engine->ForEachNeighbor(s, [this](uint32_t j) { m_mark[j] = m_stamp; });
+        }
+        return m_mark[r] != m_stamp;
+    }
+
+    virtual int64_t DoAssignStreams(int64_t) override { return 0; }
+
+    double m_maxTxPower;
+    double m_threshold;
+    double m_refresh;
+    double m_maxSpeed;
+    std::unique_ptr<ConnectivityEngine> m_engine;
+    std::vector<uint32_t> m_index;    // node id -> engine index
+    std::vector<uint32_t> m_mark;     // == m_stamp: in range of the current transmitter
+    double m_lastUpdate;
+    const SpectrumSignalParameters *m_lastParams;
+    uint32_t m_lastSender;
+    double m_lastTxTime;
+    uint32_t m_stamp;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(RangeCullFilter);
+
+// --cullThreshold: "sensitivity" and "ed" take the WifiPhy RxSensitivity / CcaEdThreshold defaults
+// (including --ns3::WifiPhy::... overrides), anything else is a value in dBm. Only thresholds at
+// or below the sensitivity leave decodable frames untouched: at the ED threshold (-62 dBm) the
+// 16 dBm access tier is culled beyond ~37 m, inside the range where 6 Mbps frames still decode.
+static double
+ResolveCullThreshold (const std::string &spec)
+{
+    if (spec == "sensitivity" || spec == "ed") {
+        TypeId::AttributeInformation info;
+        bool found = WifiPhy::GetTypeId().LookupAttributeByName(spec == "ed" ? "CcaEdThreshold" : "RxSensitivity", &info);
+        Ptr<const DoubleValue> v = found ? DynamicCast<const DoubleValue>(info.initialValue) : nullptr;
+        NS_ABORT_MSG_IF(!v, "No se puede leer el umbral de la PHY para --cullThreshold=" << spec);
+        return v->Get();
+    }
+    char *end = nullptr;
+    double dbm = std::strtod(spec.c_str(), &end);
+    NS_ABORT_MSG_IF(spec.empty() || *end != '\0', "--cullThreshold debe ser sensitivity, ed o un valor en dBm: " << spec);
+    return dbm;
+}
+
+// Spectrum channel with cached Friis loss and, with cull set, range culling for the nodes that
+// will attach to it
+Ptr<MultiModelSpectrumChannel>
+CreateCulledChannel (const NodeContainer &nodes, double maxTxPower, double threshold, double maxSpeed, bool cull = true)
+{
+    Ptr<MultiModelSpectrumChannel> channel = CreateObject<MultiModelSpectrumChannel>();
+    Ptr<CachedFriisPropagationLossModel> loss = CreateObject<CachedFriisPropagationLossModel>();
+    channel->AddPropagationLossModel(loss);
+    channel->SetPropagationDelayModel(CreateObject<ConstantSpeedPropagationDelayModel>());
+    if (!cull) return channel;
+    Ptr<RangeCullFilter> filter = CreateObject<RangeCullFilter>();
+    filter->SetAttribute("MaxTxPower", DoubleValue(maxTxPower));
+    filter->SetAttribute("Threshold", DoubleValue(threshold));
+    filter->SetAttribute("MaxSpeed", DoubleValue(maxSpeed));
+    filter->Install(nodes, loss);
+    channel->AddSpectrumTransmitFilter(filter);
+    NS_LOG_INFO("Canal con descarte por alcance: " << nodes.GetN() << " nodos, radio " << filter->GetRadius() << " m");
+    return channel;
+}
+
+// ----- Fast link layer: distance-threshold SimpleChannel -----
+// Replaces the 802.11 PHY/MAC for topology-level studies: a frame reaches every attached device
+// within Range (no contention, collisions or fading), each copy is dropped with LossProbability,
+// and the sending SimpleNetDevice serializes frames at its DataRate. Candidates come from a grid
+// refreshed every RefreshInterval; the exact distance is checked at send time.
+class RangeSimpleChannel : public SimpleChannel
+{
+public:
+    static TypeId GetTypeId()
+    {
+        static TypeId tid = TypeId("RangeSimpleChannel")
+            .SetParent<SimpleChannel>()
+            .SetGroupName("Network")
+            .AddConstructor<RangeSimpleChannel>()
+            .AddAttribute("Range", "Delivery distance (m)",
+                          DoubleValue(100.0), MakeDoubleAccessor(&RangeSimpleChannel::m_range), MakeDoubleChecker<double>(0.0))
+            .AddAttribute("LossProbability", "Independent drop probability per delivered copy",
+                          DoubleValue(0.0), MakeDoubleAccessor(&RangeSimpleChannel::m_loss), MakeDoubleChecker<double>(0.0))
+            .AddAttribute("RefreshInterval", "Period of the position snapshot (s)",
+                          DoubleValue(0.1), MakeDoubleAccessor(&RangeSimpleChannel::m_refresh), MakeDoubleChecker<double>(0.0))
+            .AddAttribute("MaxSpeed", "Upper bound on node speed, pads the candidate radius (m/s)",
+                          DoubleValue(0.0), MakeDoubleAccessor(&RangeSimpleChannel::m_maxSpeed), MakeDoubleChecker<double>(0.0));
+        return tid;
+    }
+
+    RangeSimpleChannel() : m_range(100.0), m_loss(0.0), m_refresh(0.1), m_maxSpeed(0.0), m_lastUpdate(-1.0), m_delivered(0), m_dropped(0)
+    {
+        m_rng = CreateObject<UniformRandomVariable>();
+    }
+
+    virtual void Add(Ptr<SimpleNetDevice> device) override
+    {
+        SimpleChannel::Add(device);
+        m_devices.push_back(device);
+        m_addresses.push_back(Mac48Address::ConvertFrom(device->GetAddress()));
+        m_engine.reset();
+    }
+
+    virtual void Send(Ptr<Packet> p, uint16_t protocol, Mac48Address to, Mac48Address from, Ptr<SimpleNetDevice> sender) override
+    {
+        double now = Simulator::Now().GetSeconds();
+        if (!m_engine) Build();
+        if (m_lastUpdate < 0 || now - m_lastUpdate >= m_refresh) {
+            m_engine->Update();
+            m_lastUpdate = now;
+        }
+        uint32_t s = sender->GetNode()->GetId();
+        if (s >= m_index.size() || m_index[s] == std::numeric_limits<uint32_t>::max()) return;
+        uint32_t i = m_index[s];
+        Ptr<MobilityModel> txMobility = m_devices[i]->GetNode()->GetObject<MobilityModel>();
+        bool group = to.IsGroup() || to.IsBroadcast();
+        m_engine->ForEachNeighbor(i, [&](uint32_t j) {
+            if (!group && !(m_addresses[j] == to)) return;
+            Ptr<MobilityModel> rxMobility = m_devices[j]->GetNode()->GetObject<MobilityModel>();
+            double d = (txMobility && rxMobility) ? txMobility->GetDistanceFrom(rxMobility) : 0.0;
+            if (d > m_range) return;
+            if (m_loss > 0 && m_rng->GetValue() < m_loss) { m_dropped++; return; }
+            m_delivered++;
+            Simulator::ScheduleWithContext(m_devices[j]->GetNode()->GetId(), Seconds(d / 299792458.0),
+                                           &SimpleNetDevice::Receive, m_devices[j], p->Copy(), protocol, to, from);
+        });
+    }
+
+    int64_t AssignStreams(int64_t stream)
+    {
+        m_rng->SetStream(stream);
+        return 1;
+    }
+
+    uint64_t GetDelivered() const { return m_delivered; }
+    uint64_t GetDropped() const { return m_dropped; }
+
+private:
+    void Build()
+    {
+        NodeContainer nodes;
+        m_index.clear();
+        for (uint32_t i=0;i<m_devices.size();++i) {
+            uint32_t id = m_devices[i]->GetNode()->GetId();
+            if (id >= m_index.size()) m_index.resize(id + 1, std::numeric_limits<uint32_t>::max());
+            m_index[id] = i;
+            nodes.Add(m_devices[i]->GetNode());
+        }
+        m_engine.reset(new ConnectivityEngine(nodes, m_range + 2.0 * m_maxSpeed * m_refresh));
+        m_lastUpdate = -1.0;
+    }
+
+    double m_range;
+    double m_loss;
+    double m_refresh;
+    double m_maxSpeed;
+    double m_lastUpdate;
+    uint64_t m_delivered;
+    uint64_t m_dropped;
+    Ptr<UniformRandomVariable> m_rng;
+    std::vector<Ptr<SimpleNetDevice>> m_devices;   // same order as the engine entries
+    std::vector<Mac48Address> m_addresses;
+    std::vector<uint32_t> m_index;                 // node id -> device entry
+    std::unique_ptr<ConnectivityEngine> m_engine;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(RangeSimpleChannel);
+
+// ----- Asynchronous output writer -----
+// Bounded single-producer/single-consumer ring: the simulator thread pushes, the writer thread pops.
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t capacity)
+    {
+        size_t c = 2;
+        while (c < capacity) c <<= 1;
+        m_slots.resize(c);
+        m_mask = c - 1;
+    }
+
+    bool TryPush(T &&v)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) > m_mask) return false;
+        m_slots[tail & m_mask] = std::move(v);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T &v)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) return false;
+        v = std::move(m_slots[head & m_mask]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T> m_slots;
+    size_t m_mask;
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+};
+
+// gzip child without a shell: the file is opened here and becomes the child's stdin or stdout,
+// so the path is never parsed by /bin/sh. Every descriptor is close-on-exec, so a gzip child
+// never holds another sink's pipe open. Returns our end of the pipe, or null on failure.
+static FILE *
+OpenGzipPipe (const std::string &path, bool decompress, pid_t &pid)
+{
+    int fileFd = decompress ? open(path.c_str(), O_RDONLY | O_CLOEXEC)
+                            : open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fileFd < 0) return nullptr;
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) { close(fileFd); return nullptr; }
+    pid = fork();
+    if (pid == 0) {
+        dup2(decompress ? fileFd : fds[0], STDIN_FILENO);
+        dup2(decompress ? fds[1] : fileFd, STDOUT_FILENO);
+        execlp("gzip", "gzip", decompress ? "-dc" : "-c", (char*)nullptr);
+        _exit(127);
+    }
+    close(fileFd);
+    close(decompress ? fds[1] : fds[0]);
+    int mine = decompress ? fds[0] : fds[1];
+    if (pid < 0) { close(mine); return nullptr; }
+    return fdopen(mine, decompress ? "r" : "w");
+}
+
+// Closes the pipe and reaps gzip; true when it exited cleanly
+static bool
+CloseGzipPipe (FILE *f, pid_t pid)
+{
+    fclose(f);
+    int status = 0;
+    return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Output sinks fed from the simulator thread. Bytes are staged per sink and handed over in
+// large chunks; one writer thread formats nothing and only performs buffered (or gzip) writes.
+// With async disabled the chunks are written inline, which is useful to compare wall times.
+class AsyncOutputWriter
+{
+public:
+    static constexpr size_t kChunkBytes = 256 * 1024;
+
+    AsyncOutputWriter(bool async, bool compress)
+        : m_async(async), m_compress(compress), m_queue(256), m_running(false) {}
+
+    ~AsyncOutputWriter() { Close(); }
+
+    // Returns the sink id; "-" is standard output (never compressed)
+    int AddSink(const std::string &path)
+    {
+        NS_ABORT_MSG_IF(m_running, "Los sumideros deben registrarse antes de Start()");
+        Sink s;
+        s.path = path;
+        if (path == "-") {
+            s.file = stdout;
+        } else if (m_compress) {
+            s.path += ".gz";
+            s.file = OpenGzipPipe(s.path, false, s.gzip);
+        } else {
+            s.file = fopen(path.c_str(), "wb");
+        }
+        NS_ABORT_MSG_IF(!s.file, "No se puede abrir la salida: " << s.path);
+        if (s.file != stdout) {
+            s.buffer.reset(new char[1 << 20]);
+            setvbuf(s.file, s.buffer.get(), _IOFBF, 1 << 20);
+        }
+        m_sinks.push_back(std::move(s));
+        m_staging.emplace_back();
+        m_staging.back().reserve(kChunkBytes);
+        return m_sinks.size() - 1;
+    }
+
+    const std::string &GetPath(int sink) const { return m_sinks[sink].path; }
+
+    void Start()
+    {
+        if (!m_async || m_running) return;
+        m_running = true;
+        m_thread = std::thread(&AsyncOutputWriter::Drain, this);
+    }
+
+    void Write(int sink, const void *data, size_t len)
+    {
+        std::string &buf = m_staging[sink];
+        buf.append(static_cast<const char*>(data), len);
+        if (buf.size() >= kChunkBytes) Flush(sink);
+    }
+
+    void Write(int sink, const std::string &s) { Write(sink, s.data(), s.size()); }
+
+    void Flush(int sink)
+    {
+        std::string &buf = m_staging[sink];
+        if (buf.empty()) return;
+        Chunk c{sink, std::move(buf)};
+        buf.clear();
+        buf.reserve(kChunkBytes);
+        if (!m_running) { WriteChunk(c); return; }
+        while (!m_queue.TryPush(std::move(c))) std::this_thread::yield();
+        Wake(false);
+    }
+
+    // Flush every sink, join the writer and close the files
+    void Close()
+    {
+        for (uint32_t i=0;i<m_staging.size();++i) Flush(i);
+        if (m_running) {
+            Wake(true);
+            m_thread.join();
+            m_running = false;
+        }
+        for (Sink &s : m_sinks) {
+            if (!s.file) continue;
+            if (s.gzip > 0) {
+                if (!CloseGzipPipe(s.file, s.gzip)) NS_LOG_UNCOND("gzip terminó con error: " << s.path);
+            }
+            else if (s.file == stdout) fflush(stdout);
+            else fclose(s.file);
+            s.file = nullptr;
+        }
+    }
+
+private:
+    struct Chunk {
+        int sink;
+        std::string data;
+    };
+    struct Sink {
+        std::string path;
+        FILE *file = nullptr;
+        pid_t gzip = 0;
+        std::unique_ptr<char[]> buffer;
+    };
+
+    void WriteChunk(const Chunk &c)
+    {
+        fwrite(c.data.data(), 1, c.data.size(), m_sinks[c.sink].file);
+    }
+
+    // One lock per 256 KiB chunk: the flag set under the mutex closes the gap between a failed
+    // TryPop and the wait, so a push never goes unnoticed
+    void Wake(bool stop)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending = true;
+            if (stop) m_stop = true;
+        }
+        m_wake.notify_one();
+    }
+
+    void Drain()
+    {
+        Chunk c;
+        while (true) {
+            while (m_queue.TryPop(c)) WriteChunk(c);
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_stop) break;
+            m_wake.wait(lock, [this] { return m_pending; });
+            m_pending = false;
+        }
+        // Close() pushes everything before stopping, so one last pass empties the queue
+        while (m_queue.TryPop(c)) WriteChunk(c);
+    }
+
+    bool m_async;
+    bool m_compress;
+    std::vector<Sink> m_sinks;
+    std::vector<std::string> m_staging;
+    SpscQueue<Chunk> m_queue;
+    std::thread m_thread;
+    bool m_running;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_pending = false;            // guarded by m_mutex
+    bool m_stop = false;               // guarded by m_mutex
+};
+
+// ----- Compact trace: delta-encoded routes and thresholded positions -----
+// Binary stream of fixed-layout records in host byte order:
+//   header      "MJTR" u32 version
+//   'N'         u32 node, u8 r, u8 g, u8 b, u8 size, u16 len, descr      node metadata
+//   'P'         u32 node, f64 t, f32 x, f32 y                            position (moved > threshold)
+//   'A' 'D' 'M' u32 node, f64 t, u32 dest, u32 mask, u32 gw, u32 iface, u32 metric
+//                                                                        route added / removed / metric changed
+// Route tables are snapshotted every routeInterval but only differences are written.
+// ConvertCompactTrace() turns the stream back into NetAnim animation and routing XML.
+static const uint32_t kCompactTraceVersion = 1;
+
+struct CompactRoute {
+    uint32_t gateway;
+    uint32_t iface;
+    uint32_t metric;
+    bool operator==(const CompactRoute &o) const { return gateway == o.gateway && iface == o.iface && metric == o.metric; }
+};
+typedef std::unordered_map<uint64_t, CompactRoute> CompactRouteTable; // (dest << 32 | mask) -> route
+
+// Flatten the routes known by a node's routing protocol (list, static and OLSR)
+static void
+CollectRoutes (Ptr<Ipv4RoutingProtocol> rp, CompactRouteTable &out)
+{
+    if (!rp) return;
+    Ptr<Ipv4ListRouting> list = DynamicCast<Ipv4ListRouting>(rp);
+    if (list) {
+        for (uint32_t i=0;i<list->GetNRoutingProtocols();++i) {
+            int16_t priority;
+            CollectRoutes(list->GetRoutingProtocol(i, priority), out);
+        }
+        return;
+    }
+    Ptr<Ipv4StaticRouting> st = DynamicCast<Ipv4StaticRouting>(rp);
+    if (st) {
+        for (uint32_t i=0;i<st->GetNRoutes();++i) {
+            Ipv4RoutingTableEntry e = st->GetRoute(i);
+            uint64_t key = ((uint64_t)e.GetDest().Get() << 32) | e.GetDestNetworkMask().Get();
+            out[key] = {e.GetGateway().Get(), e.GetInterface(), st->GetMetric(i)};
+        }
+        return;
+    }
+    Ptr<olsr::RoutingProtocol> ol = DynamicCast<olsr::RoutingProtocol>(rp);
+    if (ol) {
+        for (const olsr::RoutingTableEntry &e : ol->GetRoutingTableEntries()) {
+            out[((uint64_t)e.destAddr.Get() << 32) | 0xffffffff] = {e.nextAddr.Get(), e.interface, e.distance};
+        }
+    }
+}
+
+class CompactTraceWriter
+{
+public:
+    CompactTraceWriter(AsyncOutputWriter &out, int sink, double minMove, double posInterval, double routeInterval, double stopTime)
+        : m_out(out), m_sink(sink), m_minMove(minMove), m_posInterval(posInterval),
+          m_routeInterval(routeInterval), m_stopTime(stopTime), m_records(0)
+    {
+        m_out.Write(m_sink, "MJTR", 4);
+        Put(kCompactTraceVersion);
+    }
+
+    void SetNodeInfo(Ptr<Node> n, const std::string &descr, uint8_t r, uint8_t g, uint8_t b, uint8_t size)
+    {
+        uint16_t len = std::min<size_t>(descr.size(), 0xffff);
+        Put('N');
+        Put(n->GetId()); Put(r); Put(g); Put(b); Put(size); Put(len);
+        m_out.Write(m_sink, descr.data(), len);
+        m_records++;
+    }
+
+    void Start(const NodeContainer &nodes)
+    {
+        for (uint32_t i=0;i<nodes.GetN();++i) {
+            m_nodes.push_back(nodes.Get(i));
+            m_mobility.push_back(nodes.Get(i)->GetObject<MobilityModel>());
+        }
+        m_lastPos.assign(m_nodes.size(), Vector(std::numeric_limits<double>::max(), 0, 0));
+        m_tables.assign(m_nodes.size(), CompactRouteTable());
+        Simulator::ScheduleNow(&CompactTraceWriter::SamplePositions, this);
+        Simulator::ScheduleNow(&CompactTraceWriter::SampleRoutes, this);
+    }
+
+    uint64_t GetRecords() const { return m_records; }
+
+private:
+    template <typename T> void Put(const T &v) { m_out.Write(m_sink, &v, sizeof(T)); }
+
+    void SamplePositions()
+    {
+        double t = Simulator::Now().GetSeconds();
+        for (uint32_t i=0;i<m_nodes.size();++i) {
+            if (!m_mobility[i]) continue;
+            Vector p = m_mobility[i]->GetPosition();
+            const Vector &last = m_lastPos[i];
+            double dx = p.x - last.x, dy = p.y - last.y;
+            if (last.x != std::numeric_limits<double>::max() && dx*dx + dy*dy < m_minMove*m_minMove) continue;
+            m_lastPos[i] = p;
+            Put('P');
+            Put(m_nodes[i]->GetId()); Put(t); Put((float)p.x); Put((float)p.y);
+            m_records++;
+        }
+        if (t + m_posInterval <= m_stopTime) Simulator::Schedule(Seconds(m_posInterval), &CompactTraceWriter::SamplePositions, this);
+    }
+
+    void SampleRoutes()
+    {
+        double t = Simulator::Now().GetSeconds();
+        CompactRouteTable now;
+        for (uint32_t i=0;i<m_nodes.size();++i) {
+            Ptr<Ipv4> ipv4 = m_nodes[i]->GetObject<Ipv4>();
+            if (!ipv4) continue;
+            now.clear();
+            CollectRoutes(ipv4->GetRoutingProtocol(), now);
+            CompactRouteTable &prev = m_tables[i];
+            for (auto const &r : now) {
+                auto it = prev.find(r.first);
+                if (it == prev.end()) WriteRoute('A', i, t, r.first, r.second);
+                else if (!(it->second == r.second)) WriteRoute('M', i, t, r.first, r.second);
+            }
+            for (auto const &r : prev) {
+                if (now.find(r.first) == now.end()) WriteRoute('D', i, t, r.first, r.second);
+            }
+            prev.swap(now);
+        }
+        if (t + m_routeInterval <= m_stopTime) Simulator::Schedule(Seconds(m_routeInterval), &CompactTraceWriter::SampleRoutes, this);
+    }
+
+    void WriteRoute(char op, uint32_t i, double t, uint64_t key, const CompactRoute &r)
+    {
+        Put(op);
+        Put(m_nodes[i]->GetId()); Put(t);
+        Put((uint32_t)(key >> 32)); Put((uint32_t)(key & 0xffffffff));
+        Put(r.gateway); Put(r.iface); Put(r.metric);
+        m_records++;
+    }
+
+    AsyncOutputWriter &m_out;
+    int m_sink;
+    double m_minMove;
+    double m_posInterval;
+    double m_routeInterval;
+    double m_stopTime;
+    uint64_t m_records;
+    std::vector<Ptr<Node>> m_nodes;
+    std::vector<Ptr<MobilityModel>> m_mobility;
+    std::vector<Vector> m_lastPos;
+    std::vector<CompactRouteTable> m_tables;
+};
+
+// Attribute values are written by hand, so node descriptions and route dumps are escaped
+static std::string
+XmlEscape (const std::string &s)
+{
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        switch (c) {
+            case '&': out += "&amp;"; break;
+            case '<': out += "&lt;"; break;
+            case '>': out += "&gt;"; break;
+            case '"': out += "&quot;"; break;
+            default: out += c;
+        }
+    }
+    return out;
+}
+
+// Compact trace -> NetAnim animation XML (<path>.xml) and routing XML (<path>-routes.xml)
+static int
+ConvertCompactTrace (const std::string &path)
+{
+    // Traces written with --compressOutput are read back through gzip
+    std::string data, base = path;
+    if (path.size() > 3 && path.compare(path.size() - 3, 3, ".gz") == 0) {
+        base = path.substr(0, path.size() - 3);
+        pid_t gzip = 0;
+        FILE *p = OpenGzipPipe(path, true, gzip);
+        if (p) {
+            char buf[1 << 16];
+            size_t n;
+            while ((n = fread(buf, 1, sizeof(buf), p)) > 0) data.append(buf, n);
+            CloseGzipPipe(p, gzip);
+        }
+    } else {
+        std::ifstream f(path.c_str(), std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    }
+    std::istringstream is(data);
+    char magic[4];
+    uint32_t version = 0;
+    is.read(magic, 4);
+    is.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if (!is || std::string(magic, 4) != "MJTR" || version != kCompactTraceVersion) {
+        NS_LOG_UNCOND("Traza compacta no válida: " << path);
+        return 1;
+    }
+    auto get = [&is](auto &v) { is.read(reinterpret_cast<char*>(&v), sizeof(v)); return (bool)is; };
+    auto ipString = [](uint32_t a) { std::ostringstream o; o << Ipv4Address(a); return o.str(); };
+
+    std::ofstream anim((base + ".xml").c_str());
+    std::ofstream routes((base + "-routes.xml").c_str());
+    anim << "<anim ver=\"netanim-3.108\" filetype=\"animation\" >\n";
+    routes << "<anim ver=\"netanim-3.108\" filetype=\"routing\" >\n";
+
+    std::map<uint32_t, std::map<uint64_t, CompactRoute>> tables; // ordered for stable output
+    std::set<uint32_t> nodesSeen;
+    int64_t pendingNode = -1;
+    double pendingTime = 0.0;
+    auto flushRoutes = [&]() {
+        if (pendingNode < 0) return;
+        std::ostringstream info;
+        info << "Destination\tMask\tGateway\tIface\tMetric\n";
+        for (auto const &r : tables[pendingNode]) {
+            info << ipString(r.first >> 32) << "\t" << ipString(r.first & 0xffffffff) << "\t" << ipString(r.second.gateway)
+                 << "\t" << r.second.iface << "\t" << r.second.metric << "\n";
+        }
+        routes << "<rt t=\"" << pendingTime << "\" id=\"" << pendingNode << "\" info=\"" << XmlEscape(info.str()) << "\" />\n";
+        pendingNode = -1;
+    };
+
+    char op;
+    uint64_t records = 0;
+    while (is.get(op)) {
+        uint32_t node;
+        if (!get(node)) break;
+        records++;
+        if (op == 'N') {
+            uint8_t r, g, b, size; uint16_t len;
+            get(r); get(g); get(b); get(size); get(len);
+            std::string descr(len, ' ');
+            if (len > 0) is.read(&descr[0], len);
+            if (nodesSeen.insert(node).second) anim << "<node id=\"" << node << "\" sysId=\"0\" locX=\"0\" locY=\"0\" />\n";
+            anim << "<nu p=\"c\" t=\"0\" id=\"" << node << "\" r=\"" << (int)r << "\" g=\"" << (int)g << "\" b=\"" << (int)b << "\" />\n";
+            anim << "<nu p=\"d\" t=\"0\" id=\"" << node << "\" descr=\"" << XmlEscape(descr) << "\" />\n";
+            anim << "<nu p=\"s\" t=\"0\" id=\"" << node << "\" w=\"" << (int)size << "\" h=\"" << (int)size << "\" />\n";
+        } else if (op == 'P') {
+            double t; float x, y;
+            get(t); get(x); get(y);
+            if (nodesSeen.insert(node).second) anim << "<node id=\"" << node << "\" sysId=\"0\" locX=\"" << x << "\" locY=\"" << y << "\" />\n";
+            anim << "<nu p=\"p\" t=\"" << t << "\" id=\"" << node << "\" x=\"" << x << "\" y=\"" << y << "\" z=\"0\" />\n";
+        } else if (op == 'A' || op == 'D' || op == 'M') {
+            double t; uint32_t dest, mask; CompactRoute r;
+            get(t); get(dest); get(mask); get(r.gateway); get(r.iface); get(r.metric);
+            if (pendingNode != (int64_t)node || pendingTime != t) flushRoutes();
+            uint64_t key = ((uint64_t)dest << 32) | mask;
+            if (op == 'D') tables[node].erase(key);
+            else tables[node][key] = r;
+            pendingNode = node;
+            pendingTime = t;
+        } else {
+            NS_LOG_UNCOND("Registro desconocido '" << op << "' en " << path);
+            return 1;
+        }
+    }
+    flushRoutes();
+    anim << "</anim>\n";
+    routes << "</anim>\n";
+    NS_LOG_UNCOND("Convertidos " << records << " registros: " << base << ".xml, " << base << "-routes.xml");
+    return 0;
+}
+
+// ----- Windowed flow metrics -----
+enum FlowClass { FLOW_INTRA = 0, FLOW_INTER = 1, FLOW_BACKHAUL = 2 };
+static const char *kFlowClassNames[] = {"intra", "inter", "backhaul"};
+
+// Address -> (cluster, backhaul?) hash table used to classify flows in O(1)
+class FlowClassTable
+{
+public:
+    void Add(Ipv4Address a, uint32_t cluster, bool backhaul) { m_addr[a.Get()] = {cluster, backhaul}; }
+
+    // Cluster of the endpoint or -1 if the address is unknown
+    int32_t ClusterOf(Ipv4Address a) const
+    {
+        auto it = m_addr.find(a.Get());
+        return it == m_addr.end() ? -1 : (int32_t)it->second.cluster;
+    }
+
+    FlowClass Classify(Ipv4Address src, Ipv4Address dst) const
+    {
+        auto s = m_addr.find(src.Get()), d = m_addr.find(dst.Get());
+        if (s == m_addr.end() || d == m_addr.end()) return FLOW_INTER;
+        if (s->second.backhaul && d->second.backhaul) return FLOW_BACKHAUL;
+        return s->second.cluster == d->second.cluster ? FLOW_INTRA : FLOW_INTER;
+    }
+
+private:
+    struct Entry { uint32_t cluster; bool backhaul; };
+    std::unordered_map<uint32_t, Entry> m_addr;
+};
+
+// Samples FlowMonitor's cumulative counters every `window` seconds and writes the per-window
+// deltas as CSV rows per flow, per source cluster and per flow class. Per-packet work stays in
+// FlowMonitor; the collector costs O(flows) per window and keeps only the previous snapshot.
+// With a negative sink no rows are written and only the window callback is fed.
+class WindowedFlowMetrics
+{
+public:
+    WindowedFlowMetrics(Ptr<FlowMonitor> monitor, Ptr<Ipv4FlowClassifier> classifier, const FlowClassTable &classes,
+                        uint32_t numClusters, double window, double stopTime, AsyncOutputWriter &out, int sink)
+        : m_monitor(monitor), m_classifier(classifier), m_classes(classes), m_window(window), m_stopTime(stopTime),
+          m_out(out), m_sink(sink), m_bins(0), m_lastSample(0.0)
+    {
+        m_clusterAcc.assign(numClusters, Counters());
+        m_classAcc.assign(3, Counters());
+        if (m_sink >= 0) m_out.Write(m_sink, std::string("t,scope,id,class,txPackets,rxPackets,rxBytes,throughputKbps,pdr,delayMs,jitterMs,lost\n"));
+    }
+
+    struct Counters {
+        uint64_t txPackets = 0, rxPackets = 0, rxBytes = 0, lost = 0;
+        double delay = 0.0, jitter = 0.0;
+        void Add(const Counters &o) { txPackets += o.txPackets; rxPackets += o.rxPackets; rxBytes += o.rxBytes; lost += o.lost; delay += o.delay; jitter += o.jitter; }
+    };
+
+    // Called after every window with its end time, width and the totals over all flows
+    void SetWindowCallback(std::function<void(double, double, const Counters &)> cb) { m_onWindow = cb; }
+
+    void Start() { Simulator::Schedule(Seconds(m_window), &WindowedFlowMetrics::Sample, this, true); }
+
+    // Emit the trailing partial window; call after Simulator::Run()
+    void Finish() { if (Simulator::Now().GetSeconds() > m_lastSample + 1e-9) Sample(false); }
+
+    uint32_t GetBins() const { return m_bins; }
+
+private:
+    struct FlowInfo {
+        bool known = false;
+        FlowClass flowClass = FLOW_INTER;
+        int32_t cluster = -1;
+        Counters last;
+    };
+
+    FlowInfo &Info(FlowId id)
+    {
+        if (id >= m_flows.size()) m_flows.resize(std::max<size_t>(id + 1, 2*m_flows.size()));
+        FlowInfo &f = m_flows[id];
+        if (!f.known) {
+            Ipv4FlowClassifier::FiveTuple t = m_classifier->FindFlow(id);
+            f.flowClass = m_classes.Classify(t.sourceAddress, t.destinationAddress);
+            f.cluster = m_classes.ClusterOf(t.sourceAddress);
+            f.known = true;
+        }
+        return f;
+    }
+
+    void Row(double t, double dt, const char *scope, uint32_t id, const char *cls, const Counters &c)
+    {
+        if (m_sink < 0) return;
+        char line[256];
+        int n = snprintf(line, sizeof(line), "%.3f,%s,%u,%s,%llu,%llu,%llu,%.3f,%.2f,%.3f,%.3f,%llu\n", t, scope, id, cls,
+                         (unsigned long long)c.txPackets, (unsigned long long)c.rxPackets, (unsigned long long)c.rxBytes,
+                         c.rxBytes * 8.0 / dt / 1000.0,
+                         c.txPackets > 0 ? c.rxPackets * 100.0 / c.txPackets : 0.0,
+                         c.rxPackets > 0 ? c.delay * 1000.0 / c.rxPackets : 0.0,
+                         c.rxPackets > 1 ? c.jitter * 1000.0 / (c.rxPackets - 1) : 0.0,
+                         (unsigned long long)c.lost);
+        m_out.Write(m_sink, line, std::min<size_t>(n, sizeof(line) - 1));
+    }
+
+    void Sample(bool reschedule)
+    {
+        double t = Simulator::Now().GetSeconds(), dt = t - m_lastSample;
+        m_lastSample = t;
+        for (Counters &c : m_clusterAcc) c = Counters();
+        for (Counters &c : m_classAcc) c = Counters();
+        // lostPackets only advances when the monitor sweeps its in-flight table (MaxPerHopDelay)
+        m_monitor->CheckForLostPackets();
+        for (auto const &entry : m_monitor->GetFlowStats()) {
+            const FlowMonitor::FlowStats &s = entry.second;
+            FlowInfo &f = Info(entry.first);
+            Counters now;
+            now.txPackets = s.txPackets; now.rxPackets = s.rxPackets; now.rxBytes = s.rxBytes; now.lost = s.lostPackets;
+            now.delay = s.delaySum.GetSeconds(); now.jitter = s.jitterSum.GetSeconds();
+            Counters d;
+            d.txPackets = now.txPackets - f.last.txPackets; d.rxPackets = now.rxPackets - f.last.rxPackets;
+            d.rxBytes = now.rxBytes - f.last.rxBytes; d.lost = now.lost - f.last.lost;
+            d.delay = now.delay - f.last.delay; d.jitter = now.jitter - f.last.jitter;
+            f.last = now;
+            if (d.txPackets == 0 && d.rxPackets == 0) continue;
+            Row(t, dt, "flow", entry.first, kFlowClassNames[f.flowClass], d);
+            if (f.cluster >= 0 && (uint32_t)f.cluster < m_clusterAcc.size()) m_clusterAcc[f.cluster].Add(d);
+            m_classAcc[f.flowClass].Add(d);
+        }
+        for (uint32_t i=0;i<m_clusterAcc.size();++i) Row(t, dt, "cluster", i, "all", m_clusterAcc[i]);
+        for (uint32_t c=0;c<m_classAcc.size();++c) Row(t, dt, "class", c, kFlowClassNames[c], m_classAcc[c]);
+        m_bins++;
+        if (m_onWindow) {
+            Counters total;
+            for (const Counters &c : m_classAcc) total.Add(c);
+            m_onWindow(t, dt, total);
+        }
+        if (reschedule && t + m_window <= m_stopTime + 1e-9) Simulator::Schedule(Seconds(m_window), &WindowedFlowMetrics::Sample, this, true);
+    }
+
+    Ptr<FlowMonitor> m_monitor;
+    Ptr<Ipv4FlowClassifier> m_classifier;
+    const FlowClassTable &m_classes;
+    double m_window;
+    double m_stopTime;
+    AsyncOutputWriter &m_out;
+    int m_sink;
+    uint32_t m_bins;
+    double m_lastSample;
+    std::vector<FlowInfo> m_flows;        // indexed by FlowId
+    std::vector<Counters> m_clusterAcc;   // per-window accumulators, reused
+    std::vector<Counters> m_classAcc;
+    std::function<void(double, double, const Counters &)> m_onWindow;
+};
+
+// ----- Control-plane accounting -----
+// Counts OLSR packets (UDP port 698) leaving each leader, split by tier: device 0 is the access
+// interface, device 1 the backhaul (see the WiFi / fast link setup in main)
+class ControlPlaneCounter
+{
+public:
+    enum Tier { ACCESS = 0, BACKHAUL = 1 };
+
+    void Install(const NodeContainer &nodes)
+    {
+        for (uint32_t i=0;i<nodes.GetN();++i) {
+            Ptr<Ipv4L3Protocol> l3 = nodes.Get(i)->GetObject<Ipv4L3Protocol>();
+            if (l3) l3->TraceConnectWithoutContext("Tx", MakeCallback(&ControlPlaneCounter::OnTx, this));
+        }
+    }
+
+    uint64_t GetPackets(Tier t) const { return m_packets[t]; }
+    uint64_t GetBytes(Tier t) const { return m_bytes[t]; }
+
+    void Print(std::ostream &os) const
+    {
+        os << "Control OLSR: acceso " << m_packets[ACCESS] << " paquetes / " << m_bytes[ACCESS] << " bytes"
+           << "  backhaul " << m_packets[BACKHAUL] << " paquetes / " << m_bytes[BACKHAUL] << " bytes\n";
+    }
+
+private:
+    void OnTx(Ptr<const Packet> packet, Ptr<Ipv4> ipv4, uint32_t interface)
+    {
+        Ipv4Header ip;
+        packet->PeekHeader(ip);
+        if (ip.GetProtocol() != 17) return;
+        Ptr<Packet> copy = packet->Copy();
+        copy->RemoveHeader(ip);
+        UdpHeader udp;
+        copy->PeekHeader(udp);
+        if (udp.GetDestinationPort() != 698) return;
+        Ptr<NetDevice> dev = ipv4->GetNetDevice(interface);
+        Tier t = (dev && dev->GetIfIndex() == 1) ? BACKHAUL : ACCESS;
+        m_packets[t]++;
+        m_bytes[t] += packet->GetSize();
+    }
+
+    uint64_t m_packets[2] = {0, 0};
+    uint64_t m_bytes[2] = {0, 0};
+};
+
+// ----- Two-tier graph analytics -----
+// Connectivity of the whole hierarchy as the routing sees it: leaders are linked when within
+// backhaulRange, and a subordinate hangs off its own leader while within accessRange (it is
+// never a relay). Per monitor tick the backhaul links are compared with the previous tick. A
+// quiet tick costs one attachment check per subordinate; link-ups are unioned into the
+// existing union-find, and only a link-down (which may split a component) rebuilds it. The
+// articulation points (iterative Tarjan, O(leaders + links)) are recomputed on any change.
+class TwoTierGraphAnalytics
+{
+public:
+    // heads[i]: leader index of node i in the access engine (leaders are their own head)
+    TwoTierGraphAnalytics(uint32_t numLeaders, const std::vector<uint32_t> &heads)
+        : m_leaders(numLeaders), m_heads(heads), m_out(nullptr), m_sink(-1),
+          m_leaderComponents(0), m_clusterPairs(0), m_samples(0), m_detachEvents(0), m_rebuilds(0), m_unions(0)
+    {
+        m_attached.assign(heads.size(), false);
+        m_isArticulation.assign(numLeaders, false);
+        m_articulationTicks.assign(numLeaders, 0);
+    }
+
+    void SetOutput(AsyncOutputWriter *out, int sink)
+    {
+        m_out = out;
+        m_sink = sink;
+        if (m_out && m_sink >= 0) {
+            m_out->Write(m_sink, std::string("t,components,largestComponent,leaderComponents,clusterReachability,nodeReachability,detached,detachEvents,articulationLeaders\n"));
+        }
+    }
+
+    // Monitor hook; both engines have already been updated for this tick
+    void Sample(ConnectivityEngine *leaderGrid, ConnectivityEngine *accessGrid)
+    {
+        m_edges.clear();
+        leaderGrid->ForEachLink([this] (uint32_t i, uint32_t j) { m_edges.push_back(PairKey(i, j)); });
+        std::sort(m_edges.begin(), m_edges.end());
+        if (m_samples == 0 || m_edges != m_prevEdges) {
+            UpdateComponents();
+            UpdateArticulation();
+            m_prevEdges.swap(m_edges);
+        }
+
+        // Attachment pass: each subordinate joins its leader's component or is a singleton
+        // (sizes indexed by union-find root)
+        std::vector<uint32_t> size(m_leaders, 0);
+        for (uint32_t l=0;l<m_leaders;++l) size[Find(l)]++;
+        uint32_t n = std::min<uint32_t>(m_heads.size(), accessGrid->GetN()), detached = 0;
+        for (uint32_t i=m_leaders;i<n;++i) {
+            bool attached = accessGrid->InRange(i, m_heads[i]);
+            // The first sample only seeds the attachment state; it has no previous tick to detach from
+            if (m_samples > 0 && m_attached[i] && !attached) m_detachEvents++;
+            m_attached[i] = attached;
+            if (attached) size[Find(m_heads[i])]++;
+            else detached++;
+        }
+        uint32_t largest = detached > 0 ? 1 : 0;
+        double reachablePairs = 0.0;
+        for (uint32_t s : size) {
+            largest = std::max(largest, s);
+            reachablePairs += (double)s * (s - 1);
+        }
+        uint32_t components = m_leaderComponents + detached;
+        double clusterReach = m_leaders > 1 ? m_clusterPairs * 100.0 / ((double)m_leaders * (m_leaders - 1)) : 100.0;
+        double nodeReach = n > 1 ? reachablePairs * 100.0 / ((double)n * (n - 1)) : 100.0;
+        uint32_t articulation = 0;
+        for (uint32_t l=0;l<m_leaders;++l) {
+            if (!m_isArticulation[l]) continue;
+            articulation++;
+            m_articulationTicks[l]++;
+        }
+
+        m_samples++;
+        m_sum.components += components;
+        m_sum.largest += n > 0 ? largest * 100.0 / n : 0.0;
+        m_sum.clusterReach += clusterReach;
+        m_sum.nodeReach += nodeReach;
+        m_sum.detached += detached;
+        m_sum.articulation += articulation;
+
+        if (m_out && m_sink >= 0) {
+            char line[192];
+            int len = snprintf(line, sizeof(line), "%.3f,%u,%u,%u,%.2f,%.2f,%u,%llu,%u\n", Simulator::Now().GetSeconds(),
+                               components, largest, m_leaderComponents, clusterReach, nodeReach, detached,
+                               (unsigned long long)m_detachEvents, articulation);
+            m_out->Write(m_sink, line, std::min<size_t>(len, sizeof(line) - 1));
+        }
+    }
+
+    uint32_t GetSamples() const { return m_samples; }
+    uint64_t GetDetachEvents() const { return m_detachEvents; }
+    double GetMeanComponents() const { return Mean(m_sum.components); }
+    double GetMeanLargestComponent() const { return Mean(m_sum.largest); }   // % of nodes
+    double GetMeanClusterReachability() const { return Mean(m_sum.clusterReach); }
+    double GetMeanNodeReachability() const { return Mean(m_sum.nodeReach); }
+    double GetMeanArticulationLeaders() const { return Mean(m_sum.articulation); }
+
+    void Print(std::ostream &os) const
+    {
+        os << "Grafo de dos niveles (" << m_samples << " muestras, " << m_unions << " actualizaciones incrementales y "
+           << m_rebuilds << " recálculos del backhaul): componentes "
+           << GetMeanComponents() << "  componente mayor " << GetMeanLargestComponent() << "% de los nodos\n"
+           << "  alcanzabilidad entre clusters " << GetMeanClusterReachability() << "%  entre nodos " << GetMeanNodeReachability()
+           << "%  subordinados desconectados " << Mean(m_sum.detached) << "  desconexiones " << m_detachEvents << "\n"
+           << "  líderes de articulación (media) " << GetMeanArticulationLeaders();
+        std::vector<std::pair<uint32_t, uint32_t>> top;
+        for (uint32_t l=0;l<m_leaders;++l) if (m_articulationTicks[l] > 0) top.push_back({m_articulationTicks[l], l});
+        std::sort(top.rbegin(), top.rend());
+        if (!top.empty()) os << "  más frecuentes:";
+        for (uint32_t k=0;k<top.size() && k<5;++k) {
+            os << " L" << top[k].second << " (" << top[k].first * 100.0 / m_samples << "%)";
+        }
+        os << "\n";
+    }
+
+private:
+    double Mean(double sum) const { return m_samples > 0 ? sum / m_samples : 0.0; }
+
+    uint32_t Find(uint32_t x)
+    {
+        while (m_parent[x] != x) { m_parent[x] = m_parent[m_parent[x]]; x = m_parent[x]; }
+        return x;
+    }
+
+    void Union(uint32_t a, uint32_t b)
+    {
+        a = Find(a);
+        b = Find(b);
+        if (a == b) return;
+        if (m_rank[a] < m_rank[b]) std::swap(a, b);
+        m_clusterPairs += 2ull * m_rank[a] * m_rank[b];  // (x+y)(x+y-1) - x(x-1) - y(y-1)
+        m_parent[b] = a;
+        m_rank[a] += m_rank[b];
+        m_leaderComponents--;
+    }
+
+    // Union-find (union by size, path halving) for the components. If every previous link is
+    // still up, only the new ones are unioned; otherwise the forest is rebuilt from this tick.
+    void UpdateComponents()
+    {
+        if (m_samples > 0 && std::includes(m_edges.begin(), m_edges.end(), m_prevEdges.begin(), m_prevEdges.end())) {
+            m_added.clear();
+            std::set_difference(m_edges.begin(), m_edges.end(), m_prevEdges.begin(), m_prevEdges.end(), std::back_inserter(m_added));
+            for (uint64_t e : m_added) Union(e >> 32, (uint32_t)e);
+            m_unions++;
+            return;
+        }
+        m_parent.resize(m_leaders);
+        m_rank.assign(m_leaders, 1);
+        for (uint32_t l=0;l<m_leaders;++l) m_parent[l] = l;
+        m_leaderComponents = m_leaders;
+        m_clusterPairs = 0;
+        for (uint64_t e : m_edges) Union(e >> 32, (uint32_t)e);
+        m_rebuilds++;
+    }
+
+    void UpdateArticulation()
+    {
+        // CSR adjacency and iterative Tarjan (discovery time / low-link)
+        m_adjStart.assign(m_leaders + 1, 0);
+        for (uint64_t e : m_edges) { m_adjStart[(e >> 32) + 1]++; m_adjStart[(uint32_t)e + 1]++; }
+        for (uint32_t l=0;l<m_leaders;++l) m_adjStart[l+1] += m_adjStart[l];
+        m_adj.resize(m_adjStart[m_leaders]);
+        std::vector<uint32_t> fill(m_adjStart.begin(), m_adjStart.end() - 1);
+        for (uint64_t e : m_edges) {
+            uint32_t a = e >> 32, b = (uint32_t)e;
+            m_adj[fill[a]++] = b;
+            m_adj[fill[b]++] = a;
+        }
+        std::vector<uint32_t> disc(m_leaders, 0), low(m_leaders, 0), parent(m_leaders, UINT32_MAX), next(m_leaders, 0);
+        std::fill(m_isArticulation.begin(), m_isArticulation.end(), false);
+        uint32_t timer = 0;
+        std::vector<uint32_t> stack;
+        for (uint32_t root=0;root<m_leaders;++root) {
+            if (disc[root] != 0) continue;
+            uint32_t rootChildren = 0;
+            disc[root] = low[root] = ++timer;
+            next[root] = m_adjStart[root];
+            stack.push_back(root);
+            while (!stack.empty()) {
+                uint32_t u = stack.back();
+                if (next[u] < m_adjStart[u+1]) {
+                    uint32_t v = m_adj[next[u]++];
+                    if (disc[v] == 0) {
+                        parent[v] = u;
+                        disc[v] = low[v] = ++timer;
+                        next[v] = m_adjStart[v];
+                        stack.push_back(v);
+                        if (u == root) rootChildren++;
+                    } else if (v != parent[u]) {
+                        low[u] = std::min(low[u], disc[v]);
+                    }
+                    continue;
+                }
+                stack.pop_back();
+                uint32_t p = parent[u];
+                if (p == UINT32_MAX) continue;
+                low[p] = std::min(low[p], low[u]);
+                if (p != root && low[u] >= disc[p]) m_isArticulation[p] = true;
+            }
+            if (rootChildren > 1) m_isArticulation[root] = true;
+        }
+    }
+
+    uint32_t m_leaders;
+    std::vector<uint32_t> m_heads;
+    AsyncOutputWriter *m_out;
+    int m_sink;
+    std::vector<uint64_t> m_edges;        // sorted PairKey() of the backhaul links, this tick
+    std::vector<uint64_t> m_prevEdges;    // ... and at the last change
+    std::vector<uint64_t> m_added;        // links up since the last change
+    std::vector<uint32_t> m_parent;
+    std::vector<uint32_t> m_rank;         // component size at the root
+    std::vector<uint32_t> m_adjStart;
+    std::vector<uint32_t> m_adj;
+    std::vector<bool> m_isArticulation;
+    std::vector<uint32_t> m_articulationTicks;
+    std::vector<bool> m_attached;
+    uint32_t m_leaderComponents;
+    uint64_t m_clusterPairs;              // ordered leader pairs in the same component
+    uint32_t m_samples;
+    uint64_t m_detachEvents;
+    uint32_t m_rebuilds;                  // full union-find rebuilds (first tick or a link-down)
+    uint32_t m_unions;                    // link-up-only changes applied incrementally
+    struct {
+        double components = 0, largest = 0, clusterReach = 0, nodeReach = 0, detached = 0, articulation = 0;
+    } m_sum;
+};
+
+// ----- Position-oracle routing -----
+// Hop-count shortest paths over the leader backhaul graph (pairs within backhaulRange), kept
+// per source as distance + first hop and updated incrementally from LinkEventTracker:
+//  - link up: partial BFS from the endpoint whose distance improves
+//  - link down: a source is repaired only if the link carried one of its shortest paths and
+//    the far endpoint has no other parent with the same first hop; the repair re-settles just
+//    the nodes whose (distance, first hop) depended on the link
+// Destinations map to leaders by exact backhaul address or by cluster /24.
+class OracleRoutingDatabase
+{
+public:
+    static constexpr uint16_t kUnreachable = 0xffff;
+
+    explicit OracleRoutingDatabase(uint32_t numLeaders)
+        : m_n(numLeaders), m_adj(numLeaders), m_dist((size_t)numLeaders*numLeaders, kUnreachable),
+          m_first((size_t)numLeaders*numLeaders, kUnreachable), m_changes(0), m_recomputes(0), m_updateSeconds(0.0)
+    {
+        NS_ABORT_MSG_IF(numLeaders >= kUnreachable, "Enrutamiento oráculo: demasiados líderes");
+    }
+
+    void AddLeader(uint32_t leader, uint32_t nodeId, Ipv4Address backhaul, Ipv4Address subnet)
+    {
+        if (nodeId >= m_leaderOfNode.size()) m_leaderOfNode.resize(nodeId + 1, kUnreachable);
+        m_leaderOfNode[nodeId] = leader;
+        m_backhaul.resize(std::max<size_t>(m_backhaul.size(), leader + 1));
+        m_backhaul[leader] = backhaul;
+        m_byAddress[backhaul.Get()] = leader;
+        m_bySubnet[subnet.Get() & 0xffffff00] = leader;
+    }
+
+    // Initial adjacency from the tracker (after LinkEventTracker::Start) and all-sources BFS
+    void Initialize(const LinkEventTracker *tracker)
+    {
+        InitializeLinks([tracker] (uint32_t i, uint32_t j) { return tracker->IsUp(i, j); });
+    }
+
+    // Same, from any predicate up(i, j) with i < j
+    template <typename F>
+    void InitializeLinks(F up)
+    {
+        for (uint32_t i=0;i<m_n;++i) {
+            for (uint32_t j=i+1;j<m_n;++j) {
+                if (up(i, j)) { m_adj[i].push_back(j); m_adj[j].push_back(i); }
+            }
+        }
+        for (uint32_t s=0;s<m_n;++s) Recompute(s);
+    }
+
+    void OnLinkChange(uint32_t u, uint32_t v, bool up)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        if (up) {
+            m_adj[u].push_back(v);
+            m_adj[v].push_back(u);
+            for (uint32_t s=0;s<m_n;++s) {
+                uint16_t du = Dist(s, u), dv = Dist(s, v);
+                if (du != kUnreachable && (dv == kUnreachable || dv > du + 1)) Relax(s, u, v);
+                else if (dv != kUnreachable && (du == kUnreachable || du > dv + 1)) Relax(s, v, u);
+            }
+        } else {
+            RemoveEdge(u, v);
+            RemoveEdge(v, u);
+            for (uint32_t s=0;s<m_n;++s) {
+                uint16_t du = Dist(s, u), dv = Dist(s, v);
+                if (du == dv || du == kUnreachable || dv == kUnreachable) continue;
+                uint32_t near = du < dv ? u : v, far = du < dv ? v : u;
+                if (!HasAlternativeParent(s, far, near)) { Repair(s, far); m_recomputes++; }
+            }
+        }
+        m_changes++;
+        m_updateSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+    uint32_t GetNLeaders() const { return m_n; }
+    uint32_t LeaderOfNode(uint32_t nodeId) const { return nodeId < m_leaderOfNode.size() ? m_leaderOfNode[nodeId] : kUnreachable; }
+
+    uint32_t LeaderOfAddress(Ipv4Address a) const
+    {
+        auto it = m_byAddress.find(a.Get());
+        if (it != m_byAddress.end()) return it->second;
+        auto sn = m_bySubnet.find(a.Get() & 0xffffff00);
+        return sn == m_bySubnet.end() ? kUnreachable : sn->second;
+    }
+
+    // First hop from leader s towards leader d, or kUnreachable
+    uint32_t NextHop(uint32_t s, uint32_t d) const { return m_first[(size_t)s*m_n + d]; }
+    Ipv4Address GetBackhaulAddress(uint32_t leader) const { return m_backhaul[leader]; }
+
+    uint64_t GetChanges() const { return m_changes; }
+    uint64_t GetRecomputes() const { return m_recomputes; }
+    double GetUpdateSeconds() const { return m_updateSeconds; }
+
+    // Checks every source against a fresh BFS: distances must match and each first hop must be
+    // a neighbor of the source one hop closer to the destination. Returns the mismatches.
+    uint64_t Verify() const
+    {
+        uint64_t bad = 0;
+        std::vector<uint16_t> ref(m_n);
+        std::vector<std::vector<uint16_t>> all;
+        for (uint32_t s=0;s<m_n;++s) {
+            std::fill(ref.begin(), ref.end(), kUnreachable);
+            std::vector<uint32_t> queue(1, s);
+            ref[s] = 0;
+            for (size_t h=0; h<queue.size(); ++h) {
+                for (uint32_t y : m_adj[queue[h]]) {
+                    if (ref[y] != kUnreachable) continue;
+                    ref[y] = ref[queue[h]] + 1;
+                    queue.push_back(y);
+                }
+            }
+            all.push_back(ref);
+        }
+        for (uint32_t s=0;s<m_n;++s) {
+            for (uint32_t d=0;d<m_n;++d) {
+                if (Dist(s, d) != all[s][d]) { bad++; continue; }
+                if (d == s || all[s][d] == kUnreachable) continue;
+                uint32_t hop = NextHop(s, d);
+                bool adjacent = hop < m_n && std::find(m_adj[s].begin(), m_adj[s].end(), hop) != m_adj[s].end();
+                if (!adjacent || all[hop][d] != all[s][d] - 1) bad++;
+            }
+        }
+        return bad;
+    }
+
+    void Print(std::ostream &os) const
+    {
+        os << "Oráculo: cambios de enlace: " << m_changes << "  reparaciones: " << m_recomputes
+           << "  coste medio por cambio(us): " << (m_changes > 0 ? m_updateSeconds * 1e6 / m_changes : 0.0) << "\n";
+    }
+
+private:
+    uint16_t Dist(uint32_t s, uint32_t x) const { return m_dist[(size_t)s*m_n + x]; }
+
+    void RemoveEdge(uint32_t a, uint32_t b)
+    {
+        std::vector<uint32_t> &l = m_adj[a];
+        for (uint32_t k=0;k<l.size();++k) {
+            if (l[k] == b) { l[k] = l.back(); l.pop_back(); return; }
+        }
+    }
+
+    // far keeps its distance and first hop through another neighbor at the same depth as near
+    bool HasAlternativeParent(uint32_t s, uint32_t far, uint32_t near) const
+    {
+        if (far == s) return true;
+        uint16_t want = Dist(s, far) - 1;
+        uint32_t hop = NextHop(s, far);
+        for (uint32_t w : m_adj[far]) {
+            if (w == near || Dist(s, w) != want) continue;
+            if ((w == s ? far : NextHop(s, w)) == hop) return true;
+        }
+        return false;
+    }
+
+    void Recompute(uint32_t s)
+    {
+        uint16_t *dist = &m_dist[(size_t)s*m_n];
+        uint16_t *first = &m_first[(size_t)s*m_n];
+        std::fill(dist, dist + m_n, kUnreachable);
+        std::fill(first, first + m_n, kUnreachable);
+        dist[s] = 0;
+        first[s] = s;
+        m_queue.clear();
+        m_queue.push_back(s);
+        for (size_t h=0; h<m_queue.size(); ++h) {
+            uint32_t x = m_queue[h];
+            for (uint32_t y : m_adj[x]) {
+                if (dist[y] != kUnreachable) continue;
+                dist[y] = dist[x] + 1;
+                first[y] = x == s ? y : first[x];
+                m_queue.push_back(y);
+            }
+        }
+    }
+
+    // The far endpoint of a removed edge lost its last parent with the same first hop. Nodes
+    // whose (distance, first hop) hinged on it are found level by level (a node is affected when
+    // no unaffected parent gives it the same first hop), then re-settled from their unaffected
+    // neighbors in distance order. Unaffected nodes keep a valid shortest path, so the work is
+    // proportional to the affected region instead of a full BFS.
+    void Repair(uint32_t s, uint32_t far)
+    {
+        uint16_t *dist = &m_dist[(size_t)s*m_n];
+        uint16_t *first = &m_first[(size_t)s*m_n];
+        if (m_mark.size() != m_n) m_mark.assign(m_n, 0);
+        auto hopVia = [&] (uint32_t y, uint32_t z) { return y == s ? z : (uint32_t)first[y]; };
+        m_queue.clear();
+        m_queue.push_back(far);
+        m_mark[far] = 1;
+        for (size_t h=0; h<m_queue.size(); ++h) {
+            uint32_t x = m_queue[h];
+            for (uint32_t z : m_adj[x]) {
+                if (m_mark[z] || dist[z] != dist[x] + 1 || first[z] != first[x]) continue;
+                bool clean = false;
+                for (uint32_t y : m_adj[z]) {
+                    if (!m_mark[y] && dist[y] + 1 == dist[z] && hopVia(y, z) == first[z]) { clean = true; break; }
+                }
+                if (clean) continue;
+                m_mark[z] = 1;
+                m_queue.push_back(z);
+            }
+        }
+        for (uint32_t x : m_queue) { dist[x] = kUnreachable; first[x] = kUnreachable; }
+        typedef std::pair<uint16_t, uint32_t> Item;
+        std::priority_queue<Item, std::vector<Item>, std::greater<Item>> heap;
+        for (uint32_t x : m_queue) {
+            for (uint32_t y : m_adj[x]) {
+                if (m_mark[y] || dist[y] == kUnreachable || dist[y] + 1 >= dist[x]) continue;
+                dist[x] = dist[y] + 1;
+                first[x] = hopVia(y, x);
+            }
+            if (dist[x] != kUnreachable) heap.push(Item(dist[x], x));
+        }
+        while (!heap.empty()) {
+            Item it = heap.top();
+            heap.pop();
+            uint32_t x = it.second;
+            if (it.first != dist[x]) continue;
+            for (uint32_t z : m_adj[x]) {
+                if (!m_mark[z] || dist[z] <= dist[x] + 1) continue;
+                dist[z] = dist[x] + 1;
+                first[z] = first[x];
+                heap.push(Item(dist[z], z));
+            }
+        }
+        for (uint32_t x : m_queue) m_mark[x] = 0;
+    }
+
+    // Edge (from, to) just appeared and shortens the path to `to`: propagate the improvement
+    void Relax(uint32_t s, uint32_t from, uint32_t to)
+    {
+        uint16_t *dist = &m_dist[(size_t)s*m_n];
+        uint16_t *first = &m_first[(size_t)s*m_n];
+        dist[to] = dist[from] + 1;
+        first[to] = from == s ? to : first[from];
+        m_queue.clear();
+        m_queue.push_back(to);
+        for (size_t h=0; h<m_queue.size(); ++h) {
+            uint32_t x = m_queue[h];
+            for (uint32_t y : m_adj[x]) {
+                if (dist[y] != kUnreachable && dist[y] <= dist[x] + 1) continue;
+                dist[y] = dist[x] + 1;
+                first[y] = first[x];
+                m_queue.push_back(y);
+            }
+        }
+    }
+
+    uint32_t m_n;
+    std::vector<std::vector<uint32_t>> m_adj;
+    std::vector<uint16_t> m_dist;     // m_n x m_n, row = source
+    std::vector<uint16_t> m_first;    // first hop leader on a shortest path
+    std::vector<uint32_t> m_queue;
+    std::vector<uint8_t> m_mark;      // Repair(): affected nodes
+    std::vector<uint32_t> m_leaderOfNode;
+    std::vector<Ipv4Address> m_backhaul;
+    std::unordered_map<uint32_t, uint32_t> m_byAddress;
+    std::unordered_map<uint32_t, uint32_t> m_bySubnet;
+    uint64_t m_changes;
+    uint64_t m_recomputes;
+    double m_updateSeconds;
+};
+
+// Randomized check of the incremental updates: `n` leaders random-walk in a square sized for
+// about six neighbors each; every link change is applied incrementally and, every
+// `verifyEvery` changes, all sources are compared with a full BFS (OracleRoutingDatabase::Verify).
+// Reports the mean update cost; returns nonzero on any mismatch.
+static int
+RunOracleSelfTest (uint32_t n, uint32_t changes, uint32_t verifyEvery)
+{
+    const double range = 100.0;
+    double side = range * std::sqrt(M_PI * n / 6.0);
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<double> pos(0.0, side), step(-0.5*range, 0.5*range);
+    std::vector<double> x(n), y(n);
+    for (uint32_t i=0;i<n;++i) { x[i] = pos(rng); y[i] = pos(rng); }
+    auto up = [&] (uint32_t i, uint32_t j) { return std::hypot(x[i] - x[j], y[i] - y[j]) <= range; };
+    std::vector<std::vector<bool>> link(n, std::vector<bool>(n, false));
+    for (uint32_t i=0;i<n;++i) for (uint32_t j=i+1;j<n;++j) link[i][j] = up(i, j);
+
+    OracleRoutingDatabase db(n);
+    db.InitializeLinks(up);
+    uint64_t bad = db.Verify(), checks = 1;
+    uint64_t nextCheck = verifyEvery;
+    std::uniform_int_distribution<uint32_t> pick(0, n - 1);
+    while (db.GetChanges() < changes) {
+        uint32_t k = pick(rng);
+        x[k] = std::min(side, std::max(0.0, x[k] + step(rng)));
+        y[k] = std::min(side, std::max(0.0, y[k] + step(rng)));
+        for (uint32_t o=0;o<n;++o) {
+            if (o == k) continue;
+            uint32_t i = std::min(k, o), j = std::max(k, o);
+            bool now = up(i, j);
+            if (now == link[i][j]) continue;
+            link[i][j] = now;
+            db.OnLinkChange(i, j, now);
+        }
+        if (db.GetChanges() >= nextCheck) {
+            bad += db.Verify();
+            checks++;
+            nextCheck = db.GetChanges() + verifyEvery;
+        }
+    }
+    bad += db.Verify();
+    checks++;
+    double meanUs = db.GetChanges() > 0 ? db.GetUpdateSeconds() * 1e6 / db.GetChanges() : 0.0;
+    std::cout << "Autoprueba oráculo: " << n << " líderes, " << db.GetChanges() << " cambios, " << checks
+              << " verificaciones completas, " << bad << " discrepancias, " << db.GetRecomputes()
+              << " reparaciones, coste medio por cambio " << meanUs << " us\n";
+    return bad > 0 ? 1 : 0;
+}
+
+// Per-leader view of the oracle database. Forwards to other leaders and their cluster subnets
+// over the backhaul; anything else (own subnet, local delivery) is left to the lower-priority
+// static routing in the Ipv4ListRouting.
+class OracleRouting : public Ipv4RoutingProtocol
+{
+public:
+    static TypeId GetTypeId()
+    {
+        static TypeId tid = TypeId("OracleRouting")
+            .SetParent<Ipv4RoutingProtocol>()
+            .SetGroupName("Internet")
+            .AddConstructor<OracleRouting>();
+        return tid;
+    }
+
+    OracleRouting() : m_db(nullptr), m_self(OracleRoutingDatabase::kUnreachable), m_backhaulIf(-1) {}
+
+    void SetDatabase(const OracleRoutingDatabase *db) { m_db = db; }
+
+    virtual Ptr<Ipv4Route> RouteOutput(Ptr<Packet> /* p */, const Ipv4Header &header, Ptr<NetDevice> oif, Socket::SocketErrno &sockerr) override
+    {
+        Ptr<Ipv4Route> route = Lookup(header.GetDestination());
+        // Sockets bound to another device (e.g. the access interface) get no oracle route
+        if (route && oif && oif != route->GetOutputDevice()) route = nullptr;
+        sockerr = route ? Socket::ERROR_NOTERROR : Socket::ERROR_NOROUTETOHOST;
+        return route;
+    }
+
+    virtual bool RouteInput(Ptr<const Packet> p, const Ipv4Header &header, Ptr<const NetDevice> idev, const UnicastForwardCallback &ucb,
+                            const MulticastForwardCallback & /* mcb */, const LocalDeliverCallback & /* lcb */, const ErrorCallback &ecb) override
+    {
+        // Local delivery is handled by Ipv4ListRouting before this point, so this is transit
+        // traffic; like Ipv4StaticRouting, drop it when forwarding is off on the input interface
+        int32_t iif = m_ipv4 && idev ? m_ipv4->GetInterfaceForDevice(idev) : -1;
+        if (iif >= 0 && !m_ipv4->IsForwarding(iif)) {
+            ecb(p, header, Socket::ERROR_NOROUTETOHOST);
+            return true;
+        }
+        Ptr<Ipv4Route> route = Lookup(header.GetDestination());
+        if (!route) return false;
+        ucb(route, p, header);
+        return true;
+    }
+
+    virtual void NotifyInterfaceUp(uint32_t) override {}
+    virtual void NotifyInterfaceDown(uint32_t) override {}
+    virtual void NotifyAddAddress(uint32_t, Ipv4InterfaceAddress) override { m_backhaulIf = -1; }
+    virtual void NotifyRemoveAddress(uint32_t, Ipv4InterfaceAddress) override { m_backhaulIf = -1; }
+    virtual void SetIpv4(Ptr<Ipv4> ipv4) override { m_ipv4 = ipv4; }
+
+    virtual void PrintRoutingTable(Ptr<OutputStreamWrapper> stream, Time::Unit unit = Time::S) const override
+    {
+        std::ostream *os = stream->GetStream();
+        *os << "Oracle routing, leader " << m_self << "\n";
+        if (!m_db || m_self == OracleRoutingDatabase::kUnreachable) return;
+        for (uint32_t d=0;d<m_db->GetNLeaders();++d) {
+            uint32_t hop = m_db->NextHop(m_self, d);
+            if (d == m_self || hop == OracleRoutingDatabase::kUnreachable) continue;
+            *os << m_db->GetBackhaulAddress(d) << " via " << m_db->GetBackhaulAddress(hop) << "\n";
+        }
+    }
+
+private:
+    Ptr<Ipv4Route> Lookup(Ipv4Address dst)
+    {
+        if (!m_db || !m_ipv4) return nullptr;
+        if (m_self == OracleRoutingDatabase::kUnreachable) m_self = m_db->LeaderOfNode(m_ipv4->GetObject<Node>()->GetId());
+        uint32_t d = m_db->LeaderOfAddress(dst);
+        if (m_self == OracleRoutingDatabase::kUnreachable || d == OracleRoutingDatabase::kUnreachable || d == m_self) return nullptr;
+        uint32_t hop = m_db->NextHop(m_self, d);
+        if (hop == OracleRoutingDatabase::kUnreachable) return nullptr;
+        if (m_backhaulIf < 0) m_backhaulIf = m_ipv4->GetInterfaceForAddress(m_db->GetBackhaulAddress(m_self));
+        if (m_backhaulIf < 0) return nullptr;
+        Ptr<Ipv4Route> route = Create<Ipv4Route>();
+        route->SetDestination(dst);
+        route->SetGateway(m_db->GetBackhaulAddress(hop));
+        route->SetSource(m_ipv4->GetAddress(m_backhaulIf, 0).GetLocal());
+        route->SetOutputDevice(m_ipv4->GetNetDevice(m_backhaulIf));
+        return route;
+    }
+
+    Ptr<Ipv4> m_ipv4;
+    const OracleRoutingDatabase *m_db;
+    uint32_t m_self;
+    int32_t m_backhaulIf;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(OracleRouting);
+
+class OracleRoutingHelper : public Ipv4RoutingHelper
+{
+public:
+    explicit OracleRoutingHelper(const OracleRoutingDatabase *db) : m_db(db) {}
+    virtual OracleRoutingHelper *Copy() const override { return new OracleRoutingHelper(*this); }
+    virtual Ptr<Ipv4RoutingProtocol> Create(Ptr<Node> node) const override
+    {
+        Ptr<OracleRouting> agent = CreateObject<OracleRouting>();
+        agent->SetDatabase(m_db);
+        return agent;
+    }
+
+private:
+    const OracleRoutingDatabase *m_db;
+};
+
+// ----- Profiling -----
+// Event origins, taken from the demangled type of each EventImpl. MakeEvent instantiations name
+// the class of the invoked member function, or for free functions their argument types; only
+// that part is matched (see EventTarget), never the whole signature, so an argument such as a
+// Mac48Address does not turn an ARP event into a MAC one.
+enum EventOrigin { ORIGIN_MOBILITY, ORIGIN_MONITOR, ORIGIN_MACPHY, ORIGIN_APPLICATIONS, ORIGIN_ROUTING,
+                   ORIGIN_INTERNET, ORIGIN_TRACING, ORIGIN_OTHER, ORIGIN_COUNT };
+static const char *kEventOriginNames[] = {"mobility", "connectivityMonitor", "macPhy", "applications", "routing",
+                                          "internet", "tracing", "other"};
+
+struct SchedulerProfile {
+    uint64_t inserted = 0;
+    uint64_t dequeued = 0;
+    uint64_t removed = 0;
+    uint64_t cancelled = 0;                  // dequeued but cancelled, so never executed
+    uint64_t queueSize = 0;
+    uint64_t peakQueue = 0;
+    uint64_t byOrigin[ORIGIN_COUNT] = {};
+    std::vector<uint64_t> eventsPerSecond;   // dequeued, non-cancelled events per simulated second
+    std::vector<uint64_t> queuePerSecond;    // largest queue size seen in each simulated second
+    std::unordered_map<std::type_index, uint64_t> otherTypes; // executed events classified as "other"
+};
+SchedulerProfile g_schedulerProfile;
+
+static std::string
+DemangledName (const char *mangled)
+{
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+    std::string name = status == 0 && demangled ? demangled : mangled;
+    std::free(demangled);
+    return name;
+}
+
+// Part of a MakeEvent type that identifies the callback:
+//   MakeEvent<void (ns3::Class::*)(...), ...>::EventMemberImpl  -> "ns3::Class"
+//   MakeEvent<void (*)(A, B), ...>::EventFunctionImpl           -> "A, B"
+// Anything else (lambdas, std::function) yields "" and is counted as "other".
+static std::string
+EventTarget (const std::string &name)
+{
+    size_t member = name.find("::*)");
+    if (member != std::string::npos) {
+        size_t open = name.rfind('(', member);
+        if (open != std::string::npos) return name.substr(open + 1, member - open - 1);
+    }
+    size_t function = name.find("(*)(");
+    if (function != std::string::npos) {
+        size_t close = name.find(')', function + 4);
+        if (close != std::string::npos) return name.substr(function + 4, close - function - 4);
+    }
+    return "";
+}
+
+// Checked in order against EventTarget(), first match wins
+static const std::vector<std::pair<const char*, EventOrigin>> kEventOriginPatterns = {
+    {"AnimationInterface", ORIGIN_TRACING}, {"CompactTraceWriter", ORIGIN_TRACING}, {"WindowedFlowMetrics", ORIGIN_TRACING},
+    {"FlowMonitor", ORIGIN_TRACING}, {"FlowProbe", ORIGIN_TRACING},
+    {"ConnectivityEngine", ORIGIN_MONITOR}, {"LinkEventTracker", ORIGIN_MONITOR}, {"OracleRoutingDatabase", ORIGIN_MONITOR},
+    {"MobilityModel", ORIGIN_MOBILITY},
+    {"ns3::olsr::", ORIGIN_ROUTING}, {"OracleRouting", ORIGIN_ROUTING},
+    {"Application", ORIGIN_APPLICATIONS}, {"OnOff", ORIGIN_APPLICATIONS}, {"PacketSink", ORIGIN_APPLICATIONS},
+    {"MultiFlow", ORIGIN_APPLICATIONS},
+    {"Wifi", ORIGIN_MACPHY}, {"Phy", ORIGIN_MACPHY}, {"Txop", ORIGIN_MACPHY}, {"ChannelAccess", ORIGIN_MACPHY},
+    {"Spectrum", ORIGIN_MACPHY}, {"Channel", ORIGIN_MACPHY}, {"NetDevice", ORIGIN_MACPHY}, {"Interference", ORIGIN_MACPHY},
+    {"Ipv4", ORIGIN_INTERNET}, {"Arp", ORIGIN_INTERNET}, {"Udp", ORIGIN_INTERNET}, {"Icmp", ORIGIN_INTERNET},
+    {"Socket", ORIGIN_INTERNET}, {"TrafficControl", ORIGIN_INTERNET}, {"QueueDisc", ORIGIN_INTERNET},
+};
+
+static EventOrigin
+ClassifyEventType (const std::type_info &type)
+{
+    static std::unordered_map<std::type_index, EventOrigin> cache;
+    auto it = cache.find(std::type_index(type));
+    if (it != cache.end()) return it->second;
+    std::string target = EventTarget(DemangledName(type.name()));
+    EventOrigin o = ORIGIN_OTHER;
+    for (auto const &p : kEventOriginPatterns) {
+        if (!target.empty() && target.find(p.first) != std::string::npos) { o = p.second; break; }
+    }
+    cache.emplace(std::type_index(type), o);
+    return o;
+}
+
+// MapScheduler that feeds g_schedulerProfile; selected with --profile
+class CountingMapScheduler : public MapScheduler
+{
+public:
+    static TypeId GetTypeId()
+    {
+        static TypeId tid = TypeId("CountingMapScheduler")
+            .SetParent<MapScheduler>()
+            .SetGroupName("Core")
+            .AddConstructor<CountingMapScheduler>();
+        return tid;
+    }
+
+    virtual void Insert(const Event &ev) override
+    {
+        MapScheduler::Insert(ev);
+        SchedulerProfile &p = g_schedulerProfile;
+        p.inserted++;
+        p.peakQueue = std::max(p.peakQueue, ++p.queueSize);
+        uint64_t sec = Second(Simulator::Now().GetTimeStep());
+        if (sec >= p.queuePerSecond.size()) {
+            p.eventsPerSecond.resize(sec + 1, 0);
+            p.queuePerSecond.resize(sec + 1, 0);
+        }
+        p.queuePerSecond[sec] = std::max(p.queuePerSecond[sec], p.queueSize);
+    }
+
+    virtual Event RemoveNext() override
+    {
+        Event ev = MapScheduler::RemoveNext();
+        SchedulerProfile &p = g_schedulerProfile;
+        p.dequeued++;
+        p.queueSize--;
+        uint64_t sec = Second(ev.key.m_ts);
+        if (sec >= p.eventsPerSecond.size()) {
+            p.eventsPerSecond.resize(sec + 1, 0);
+            p.queuePerSecond.resize(sec + 1, 0);
+        }
+        p.queuePerSecond[sec] = std::max(p.queuePerSecond[sec], p.queueSize);
+        // Cancelled events still leave through RemoveNext but are never invoked
+        if (ev.impl && ev.impl->IsCancelled()) {
+            p.cancelled++;
+            return ev;
+        }
+        p.eventsPerSecond[sec]++;
+        if (ev.impl) {
+            if (typeid(*ev.impl) != *m_lastType) {
+                m_lastType = &typeid(*ev.impl);
+                m_lastOrigin = ClassifyEventType(*m_lastType);
+            }
+            p.byOrigin[m_lastOrigin]++;
+            if (m_lastOrigin == ORIGIN_OTHER) p.otherTypes[std::type_index(*m_lastType)]++;
+        }
+        return ev;
+    }
+
+    virtual void Remove(const Event &ev) override
+    {
+        MapScheduler::Remove(ev);
+        g_schedulerProfile.removed++;
+        g_schedulerProfile.queueSize--;
+    }
+
+private:
+    static uint64_t Second(uint64_t ts) { return (uint64_t)TimeStep(ts).GetSeconds(); }
+
+    const std::type_info *m_lastType = &typeid(void);
+    EventOrigin m_lastOrigin = ORIGIN_OTHER;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(CountingMapScheduler);
+
+// Wall time between consecutive Mark() calls, labelled by the phase that just ended
+class PhaseTimer
+{
+public:
+    PhaseTimer() : m_last(std::chrono::steady_clock::now()) {}
+
+    void Mark(const std::string &phase)
+    {
+        auto now = std::chrono::steady_clock::now();
+        m_phases.push_back({phase, std::chrono::duration<double>(now - m_last).count()});
+        m_last = now;
+    }
+
+    const std::vector<std::pair<std::string, double>> &GetPhases() const { return m_phases; }
+
+    double Get(const std::string &phase) const
+    {
+        for (auto const &p : m_phases) if (p.first == phase) return p.second;
+        return 0.0;
+    }
+
+private:
+    std::chrono::steady_clock::time_point m_last;
+    std::vector<std::pair<std::string, double>> m_phases;
+};
+
+static uint64_t
+PeakRssKb ()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss; // kilobytes on Linux
+}
+
+static void
+WriteProfileJson (const std::string &path, const PhaseTimer &phases, const SimulationParams &params, uint32_t nodes)
+{
+    const SchedulerProfile &p = g_schedulerProfile;
+    std::ofstream os(path.c_str());
+    auto array = [&os](const std::vector<uint64_t> &v) {
+        os << "[";
+        for (uint32_t i=0;i<v.size();++i) os << (i ? "," : "") << v[i];
+        os << "]";
+    };
+    double total = 0.0;
+    os << "{\n  \"scenario\": {\"numClusters\": " << params.numClusters << ", \"nodes\": " << nodes
+       << ", \"simulationTime\": " << params.simulationTime << ", \"rngRun\": " << params.rngRun
+       << ", \"linkMode\": \"" << params.linkMode << "\", \"channel\": \"" << params.channel
+       << "\", \"routing\": \"" << params.routing << "\", \"traceMode\": \"" << params.traceMode << "\"},\n";
+    os << "  \"phases\": {";
+    for (uint32_t i=0;i<phases.GetPhases().size();++i) {
+        os << (i ? ", " : "") << "\"" << phases.GetPhases()[i].first << "\": " << phases.GetPhases()[i].second;
+        total += phases.GetPhases()[i].second;
+    }
+    os << "},\n  \"wallSeconds\": " << total << ",\n";
+    os << "  \"peakRssKb\": " << PeakRssKb() << ",\n";
+    os << "  \"events\": {\"executed\": " << Simulator::GetEventCount() << ", \"inserted\": " << p.inserted
+       << ", \"dequeued\": " << p.dequeued << ", \"removed\": " << p.removed << ", \"cancelled\": " << p.cancelled
+       << ", \"peakQueue\": " << p.peakQueue << "},\n";
+    os << "  \"eventsByOrigin\": {";
+    for (uint32_t o=0;o<ORIGIN_COUNT;++o) os << (o ? ", " : "") << "\"" << kEventOriginNames[o] << "\": " << p.byOrigin[o];
+    // Most frequent event types that matched no pattern, to spot a missing one
+    std::vector<std::pair<uint64_t, std::string>> other;
+    for (auto const &t : p.otherTypes) other.push_back({t.second, DemangledName(t.first.name())});
+    std::sort(other.rbegin(), other.rend());
+    os << "},\n  \"otherEventTypes\": {";
+    for (uint32_t i=0;i<other.size() && i<10;++i) os << (i ? ", " : "") << "\"" << other[i].second << "\": " << other[i].first;
+    os << "},\n  \"eventsPerSimSecond\": ";
+    array(p.eventsPerSecond);
+    os << ",\n  \"queueSizePerSimSecond\": ";
+    array(p.queuePerSecond);
+    os << "\n}\n";
+}
+
+// ----- Parameter sweep / replication runner -----
+// A sweep re-executes this same binary once per (configuration, RngRun) combination, up to
+// --jobs processes at a time. Each child writes a one-row CSV summary (see WriteRunSummary)
+// and the parent aggregates the rows per configuration with 95% confidence intervals.
+struct SweepConfig {
+    std::string clusters;      // e.g. "2,3"
+    std::string nodes;         // nodes per cluster, e.g. "3,6"
+    std::string speeds;        // leader speeds, e.g. "4,8"
+    std::string trajectories;  // e.g. "circular,zigzag"
+    std::string runs;          // explicit RngRun list, e.g. "1,2,3"
+    uint32_t replications;     // used when runs is empty: RngRun 1..replications
+    uint32_t jobs;
+};
+
+// Columns of a run summary that identify its configuration (everything else is a metric)
+static const std::vector<std::string> kConfigColumns = {"numClusters", "nodesPerCluster", "leaderSpeed", "trajectory", "rngRun"};
+
+struct RunSummary {
+    std::vector<std::pair<std::string, std::string>> config;
+    std::vector<std::pair<std::string, double>> metrics;
+};
+
+static std::vector<std::string>
+SplitList (const std::string &list)
+{
+    std::vector<std::string> out;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) out.push_back(item);
+    }
+    return out;
+}
+
+static void
+WriteRunSummary (const std::string &path, const RunSummary &summary)
+{
+    std::ofstream os(path.c_str());
+    bool first = true;
+    for (auto const &c : summary.config) { os << (first ? "" : ",") << c.first; first = false; }
+    for (auto const &m : summary.metrics) os << "," << m.first;
+    os << "\n";
+    first = true;
+    for (auto const &c : summary.config) { os << (first ? "" : ",") << c.second; first = false; }
+    for (auto const &m : summary.metrics) os << "," << m.second;
+    os << "\n";
+}
+
+static bool
+ReadRunSummary (const std::string &path, RunSummary &summary)
+{
+    std::ifstream is(path.c_str());
+    std::string header, values;
+    if (!std::getline(is, header) || !std::getline(is, values)) return false;
+    std::vector<std::string> names = SplitList(header), vals = SplitList(values);
+    if (names.size() != vals.size()) return false;
+    for (uint32_t k=0;k<names.size();++k) {
+        if (std::find(kConfigColumns.begin(), kConfigColumns.end(), names[k]) != kConfigColumns.end()) {
+            summary.config.push_back({names[k], vals[k]});
+        } else {
+            summary.metrics.push_back({names[k], std::atof(vals[k].c_str())});
+        }
+    }
+    return true;
+}
+
+// Two-sided 95% Student-t quantile
+static double
+StudentT95 (uint32_t dof)
+{
+    static const double t[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                               2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                               2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (dof == 0) return 0.0;
+    return dof <= 30 ? t[dof-1] : 1.960;
+}
+
+// Mean and 95% CI half-width of a sample
+static void
+MeanConfidence (const std::vector<double> &x, double &mean, double &halfWidth)
+{
+    mean = 0.0; halfWidth = 0.0;
+    if (x.empty()) return;
+    for (double v : x) mean += v;
+    mean /= x.size();
+    if (x.size() < 2) return;
+    double var = 0.0;
+    for (double v : x) var += (v - mean)*(v - mean);
+    var /= (x.size() - 1);
+    halfWidth = StudentT95(x.size() - 1) * std::sqrt(var / x.size());
+}
+
+// Command-line form of the scenario parameters, so a child run reproduces the parent's setup
+static std::vector<std::string>
+ScenarioArgs (const SimulationParams &p)
+{
+    std::vector<std::string> a;
+    a.push_back("--numClusters=" + std::to_string(p.numClusters));
+    a.push_back("--simTime=" + std::to_string(p.simulationTime));
+    a.push_back("--leaderSpeed=" + std::to_string(p.leaderSpeed));
+    a.push_back("--nodesPerCluster=" + std::to_string(p.nodesPerCluster));
+    if (!p.trajectory.empty()) a.push_back("--trajectory=" + p.trajectory);
+    a.push_back("--rngRun=" + std::to_string(p.rngRun));
+    a.push_back("--monitorInterval=" + std::to_string(p.monitorInterval));
+    a.push_back("--backhaulRange=" + std::to_string(p.backhaulRange));
+    a.push_back("--accessRange=" + std::to_string(p.accessRange));
+    a.push_back("--connectivityMode=" + p.connectivityMode);
+    a.push_back("--interClusterDistance=" + std::to_string(p.interClusterDistance));
+    a.push_back("--layout=" + p.layout);
+    a.push_back("--clusterSize=" + p.clusterSize);
+    a.push_back("--trajectoryMix=" + p.trajectoryMix);
+    a.push_back("--traffic=" + p.traffic);
+    a.push_back("--trafficK=" + std::to_string(p.trafficK));
+    a.push_back("--flowRate=" + p.flowRate);
+    a.push_back("--trafficProfile=" + p.trafficProfile);
+    a.push_back("--trafficEndpoints=" + p.trafficEndpoints);
+    a.push_back("--burstOn=" + std::to_string(p.burstOn));
+    a.push_back("--burstOff=" + std::to_string(p.burstOff));
+    a.push_back("--traceMode=" + p.traceMode);
+    a.push_back("--traceMinMove=" + std::to_string(p.traceMinMove));
+    a.push_back("--outputs=" + p.outputs);
+    a.push_back("--metricsWindow=" + std::to_string(p.metricsWindow));
+    a.push_back("--graphAnalytics=" + std::to_string(p.graphAnalytics));
+    a.push_back("--steadyState=" + std::to_string(p.steadyState));
+    a.push_back("--steadyPrecision=" + std::to_string(p.steadyPrecision));
+    a.push_back("--steadyWarmup=" + std::to_string(p.steadyWarmup));
+    a.push_back("--steadyBatches=" + std::to_string(p.steadyBatches));
+    a.push_back("--channel=" + p.channel);
+    a.push_back("--cullThreshold=" + p.cullThreshold);
+    a.push_back("--linkMode=" + p.linkMode);
+    a.push_back("--fastRate=" + p.fastRate);
+    a.push_back("--fastLoss=" + std::to_string(p.fastLoss));
+    a.push_back("--routing=" + p.routing);
+    a.push_back("--summaryFlows=" + std::to_string(p.summaryFlows));
+    if (!p.replayMobility.empty()) a.push_back("--replayMobility=" + p.replayMobility);
+    a.push_back("--asyncOutput=" + std::to_string(p.asyncOutput));
+    a.push_back("--compressOutput=" + std::to_string(p.compressOutput));
+    return a;
+}
+
+// fork() + exec() of this binary with stdout/stderr redirected to logFile
+static pid_t
+LaunchRun (const std::string &program, const std::vector<std::string> &args, const std::string &logFile)
+{
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+    int fd = open(logFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) { dup2(fd, STDOUT_FILENO); dup2(fd, STDERR_FILENO); close(fd); }
+    std::vector<char*> argv;
+    std::string prog = program;
+    argv.push_back(&prog[0]);
+    std::vector<std::string> copy = args;
+    for (std::string &s : copy) argv.push_back(&s[0]);
+    argv.push_back(nullptr);
+    execv("/proc/self/exe", argv.data());
+    _exit(127);
+}
+
+// Runs every argument list as a child of this binary, at most `jobs` at a time; the log of
+// child k is <logStem>k.log. Returns the number of children that failed.
+static uint32_t
+RunChildren (const std::string &program, const std::vector<std::vector<std::string>> &argLists, const std::string &logStem, uint32_t jobs)
+{
+    uint32_t next = 0, running = 0, failed = 0;
+    while (next < argLists.size() || running > 0) {
+        while (running < jobs && next < argLists.size()) {
+            if (LaunchRun(program, argLists[next], logStem + std::to_string(next) + ".log") < 0) { failed++; }
+            else running++;
+            next++;
+        }
+        int status = 0;
+        if (waitpid(-1, &status, 0) > 0) {
+            running--;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+        } else {
+            running = 0;
+        }
+    }
+    return failed;
+}
+
+// Aggregate one summary file per run into a per-configuration table with 95% CIs
+static void
+AggregateRunSummaries (const std::vector<std::string> &files, const std::string &csvPath, std::ostream &os)
+{
+    std::vector<std::string> order;
+    std::map<std::string, std::vector<RunSummary>> groups;
+    std::map<std::string, std::vector<std::pair<std::string, std::string>>> groupConfig;
+    uint32_t failed = 0;
+    for (const std::string &f : files) {
+        RunSummary s;
+        if (!ReadRunSummary(f, s)) { failed++; continue; }
+        std::string key;
+        std::vector<std::pair<std::string, std::string>> cfg;
+        for (auto const &c : s.config) {
+            if (c.first == "rngRun") continue;
+            key += c.first + "=" + c.second + " ";
+            cfg.push_back(c);
+        }
+        if (groups.find(key) == groups.end()) { order.push_back(key); groupConfig[key] = cfg; }
+        groups[key].push_back(s);
+    }
+
+    // Union of metric names over every group (e.g. per-flow columns differ between scenarios),
+    // in first-seen order; a group without a metric gets empty cells
+    std::vector<std::string> metricNames;
+    for (const std::string &key : order) {
+        for (const RunSummary &r : groups[key]) {
+            for (auto const &m : r.metrics) {
+                if (std::find(metricNames.begin(), metricNames.end(), m.first) == metricNames.end()) metricNames.push_back(m.first);
+            }
+        }
+    }
+
+    std::ofstream csv(csvPath.c_str());
+    if (!order.empty()) {
+        for (auto const &c : groupConfig[order[0]]) csv << c.first << ",";
+        csv << "runs";
+        for (const std::string &m : metricNames) csv << "," << m << "_mean," << m << "_ci95";
+        csv << "\n";
+    }
+    os << "\n--- Barrido: " << files.size() - failed << " ejecuciones correctas, " << failed << " fallidas ---\n";
+    for (const std::string &key : order) {
+        const std::vector<RunSummary> &runs = groups[key];
+        for (auto const &c : groupConfig[key]) csv << c.second << ",";
+        csv << runs.size();
+        os << key << "(n=" << runs.size() << ")\n";
+        for (const std::string &name : metricNames) {
+            std::vector<double> xs;
+            for (const RunSummary &r : runs) {
+                for (auto const &m : r.metrics) if (m.first == name) xs.push_back(m.second);
+            }
+            if (xs.empty()) { csv << ",,"; continue; }
+            double mean, hw;
+            MeanConfidence(xs, mean, hw);
+            csv << "," << mean << "," << hw;
+            os << "  " << name << ": " << mean << " ± " << hw << "\n";
+        }
+        csv << "\n";
+    }
+    NS_LOG_UNCOND("Resumen del barrido: " << csvPath);
+}
+
+static int
+RunSweep (const SimulationParams &base, const SweepConfig &sweep, const std::string &program, const std::string &outDir)
+{
+    std::string sweepDir = outDir + "/sweep";
+    mkdir(sweepDir.c_str(), 0755);
+
+    auto orDefault = [](const std::string &list, const std::string &def) {
+        std::vector<std::string> v = SplitList(list);
+        if (v.empty()) v.push_back(def);
+        return v;
+    };
+    std::vector<std::string> clusters = orDefault(sweep.clusters, std::to_string(base.numClusters));
+    std::vector<std::string> nodes = orDefault(sweep.nodes, std::to_string(base.nodesPerCluster));
+    std::vector<std::string> speeds = orDefault(sweep.speeds, std::to_string(base.leaderSpeed));
+    std::vector<std::string> trajectories = orDefault(sweep.trajectories, base.trajectory);
+    std::vector<std::string> runs = SplitList(sweep.runs);
+    if (runs.empty()) {
+        for (uint32_t r=1;r<=std::max(1u, sweep.replications);++r) runs.push_back(std::to_string(r));
+    }
+
+    std::vector<SimulationParams> variants;
+    for (const std::string &c : clusters)
+        for (const std::string &n : nodes)
+            for (const std::string &v : speeds)
+                for (const std::string &t : trajectories)
+                    for (const std::string &r : runs) {
+                        SimulationParams p = base;
+                        p.numClusters = std::atoi(c.c_str());
+                        p.nodesPerCluster = std::atoi(n.c_str());
+                        p.leaderSpeed = std::atof(v.c_str());
+                        p.trajectory = t;
+                        p.rngRun = std::atoi(r.c_str());
+                        variants.push_back(p);
+                    }
+
+    uint32_t jobs = sweep.jobs > 0 ? sweep.jobs : std::max(1u, std::thread::hardware_concurrency());
+    NS_LOG_UNCOND("Barrido: " << variants.size() << " ejecuciones en " << jobs << " procesos");
+
+    std::vector<std::string> summaries;
+    std::vector<std::vector<std::string>> argLists;
+    for (uint32_t k=0;k<variants.size();++k) {
+        std::string stem = sweepDir + "/run-" + std::to_string(k);
+        argLists.push_back(ScenarioArgs(variants[k]));
+        argLists.back().push_back("--anim=0");
+        argLists.back().push_back("--summaryFile=" + stem + ".csv");
+        summaries.push_back(stem + ".csv");
+    }
+    uint32_t failed = RunChildren(program, argLists, sweepDir + "/run-", jobs);
+    if (failed > 0) NS_LOG_UNCOND("Barrido: " << failed << " ejecuciones terminaron con error (ver " << sweepDir << "/*.log)");
+    AggregateRunSummaries(summaries, sweepDir + "/sweep-summary.csv", std::cout);
+    return failed > 0 ? 1 : 0;
+}
+
+// Same scenario with the full WiFi stack and with --linkMode=fast, one child per mode and seed;
+// prints mean ± 95% CI of the report metrics and the wall-time speedup
+static int
+ValidateFastMode (const SimulationParams &base, const SweepConfig &sweep, const std::string &program, const std::string &outDir)
+{
+    std::string dir = outDir + "/validate";
+    mkdir(dir.c_str(), 0755);
+    const std::vector<std::string> modes = {"wifi", "fast"};
+    uint32_t reps = std::max(1u, sweep.replications);
+    std::vector<std::vector<std::string>> argLists;
+    std::vector<std::string> summaries;
+    for (const std::string &m : modes) {
+        for (uint32_t r=0;r<reps;++r) {
+            SimulationParams p = base;
+            p.linkMode = m;
+            p.rngRun = base.rngRun + r;
+            std::string stem = dir + "/run-" + std::to_string(argLists.size());
+            argLists.push_back(ScenarioArgs(p));
+            argLists.back().push_back("--anim=0");
+            argLists.back().push_back("--outputs=none");
+            argLists.back().push_back("--summaryFile=" + stem + ".csv");
+            summaries.push_back(stem + ".csv");
+        }
+    }
+    uint32_t jobs = sweep.jobs > 0 ? sweep.jobs : std::max(1u, std::thread::hardware_concurrency());
+    NS_LOG_UNCOND("Validación modo fast: " << argLists.size() << " ejecuciones en " << jobs << " procesos (alcance fast: acceso "
+                  << base.accessRange << " m, backhaul " << base.backhaulRange << " m)");
+    uint32_t failed = RunChildren(program, argLists, dir + "/run-", jobs);
+
+    const std::vector<std::string> metrics = {"pdr", "meanDelayMs", "interPdr", "throughputKbps", "wallSeconds"};
+    std::vector<std::map<std::string, std::vector<double>>> values(modes.size());
+    for (uint32_t k=0;k<summaries.size();++k) {
+        RunSummary s;
+        if (!ReadRunSummary(summaries[k], s)) continue;
+        for (auto const &m : s.metrics) values[k / reps][m.first].push_back(m.second);
+    }
+    std::ofstream csv((dir + "/validate-summary.csv").c_str());
+    csv << "metric,wifiMean,wifiCi95,fastMean,fastCi95,difference\n";
+    std::cout << "\n--- Validación: wifi vs fast (" << reps << " réplicas) ---\n";
+    double wallWifi = 0.0, wallFast = 0.0;
+    for (const std::string &name : metrics) {
+        double mw, hw, mf, hf;
+        MeanConfidence(values[0][name], mw, hw);
+        MeanConfidence(values[1][name], mf, hf);
+        if (name == "wallSeconds") { wallWifi = mw; wallFast = mf; }
+        csv << name << "," << mw << "," << hw << "," << mf << "," << hf << "," << (mf - mw) << "\n";
+        std::cout << name << ": wifi " << mw << " ± " << hw << "  fast " << mf << " ± " << hf << "  diferencia " << (mf - mw) << "\n";
+    }
+    if (wallFast > 0) std::cout << "Aceleración (tiempo de pared): x" << wallWifi / wallFast << "\n";
+    if (failed > 0) NS_LOG_UNCOND("Validación: " << failed << " ejecuciones terminaron con error (ver " << dir << "/*.log)");
+    return failed > 0 ? 1 : 0;
+}
+
+// Ramps the per-flow offered load until the PDR drops below pdrThreshold: doubling (or halving
+// when the base load is already saturated) brackets the knee, then a few geometric bisection
+// steps refine it. Each load point runs `replications` seeds in parallel. The saturation
+// throughput is the largest delivered throughput seen over the ramp.
+static int
+RunSaturationSearch (const SimulationParams &base, const SweepConfig &sweep, const std::string &program,
+                     const std::string &outDir, double pdrThreshold)
+{
+    std::string dir = outDir + "/saturation";
+    mkdir(dir.c_str(), 0755);
+    uint32_t reps = std::max(1u, sweep.replications);
+    uint32_t jobs = sweep.jobs > 0 ? sweep.jobs : std::max(1u, std::thread::hardware_concurrency());
+    const uint32_t kMaxSteps = 10, kBisections = 4;
+
+    std::ofstream csv((dir + "/saturation.csv").c_str());
+    csv << "flowRateKbps,offeredKbps,deliveredKbps,deliveredCi95,pdr,pdrCi95,saturated\n";
+    std::cout << "\n--- Búsqueda de saturación (PDR umbral " << pdrThreshold << "%, " << reps << " réplicas) ---\n";
+    uint32_t point = 0, failed = 0;
+    double bestDelivered = 0.0, bestRate = 0.0;
+    // Runs one load point; true when it is saturated
+    auto measure = [&] (double rateBps) {
+        std::vector<std::vector<std::string>> argLists;
+        std::vector<std::string> summaries;
+        for (uint32_t r=0;r<reps;++r) {
+            SimulationParams p = base;
+            p.flowRate = std::to_string((uint64_t)rateBps) + "bps";
+            p.rngRun = base.rngRun + r;
+            std::string stem = dir + "/p" + std::to_string(point) + "-" + std::to_string(r);
+            argLists.push_back(ScenarioArgs(p));
+            argLists.back().push_back("--anim=0");
+            argLists.back().push_back("--outputs=none");
+            argLists.back().push_back("--summaryFile=" + stem + ".csv");
+            summaries.push_back(stem + ".csv");
+        }
+        failed += RunChildren(program, argLists, dir + "/p" + std::to_string(point) + "-", jobs);
+        point++;
+        std::map<std::string, std::vector<double>> values;
+        for (const std::string &f : summaries) {
+            RunSummary s;
+            if (!ReadRunSummary(f, s)) continue;
+            for (auto const &m : s.metrics) values[m.first].push_back(m.second);
+        }
+        double offered, offeredHw, delivered, deliveredHw, pdr, pdrHw;
+        MeanConfidence(values["offeredKbps"], offered, offeredHw);
+        MeanConfidence(values["throughputKbps"], delivered, deliveredHw);
+        MeanConfidence(values["pdr"], pdr, pdrHw);
+        bool saturated = values["pdr"].empty() || pdr < pdrThreshold;
+        if (delivered > bestDelivered) { bestDelivered = delivered; bestRate = rateBps; }
+        csv << rateBps / 1000.0 << "," << offered << "," << delivered << "," << deliveredHw << "," << pdr << "," << pdrHw << "," << saturated << "\n";
+        std::cout << "flujo " << rateBps / 1000.0 << " kbps: ofrecido " << offered << " kbps, entregado " << delivered << " ± " << deliveredHw
+                  << " kbps, PDR " << pdr << "%" << (saturated ? "  [saturado]" : "") << "\n";
+        return saturated;
+    };
+
+    double rate = DataRate(base.flowRate).GetBitRate();
+    double lo = 0.0, hi = 0.0; // highest unsaturated / lowest saturated per-flow rate
+    if (measure(rate)) {
+        hi = rate;
+        for (uint32_t k=0;k<kMaxSteps && lo == 0.0;++k) {
+            rate /= 2.0;
+            if (measure(rate)) hi = rate; else lo = rate;
+        }
+    } else {
+        lo = rate;
+        for (uint32_t k=0;k<kMaxSteps && hi == 0.0;++k) {
+            rate *= 2.0;
+            if (measure(rate)) hi = rate; else lo = rate;
+        }
+    }
+    for (uint32_t k=0;k<kBisections && lo > 0.0 && hi > 0.0;++k) {
+        double mid = std::sqrt(lo * hi);
+        if (measure(mid)) hi = mid; else lo = mid;
+    }
+    if (lo > 0.0 && hi > 0.0) std::cout << "Rodilla: entre " << lo / 1000.0 << " y " << hi / 1000.0 << " kbps por flujo\n";
+    else std::cout << "No se encontró la rodilla en " << kMaxSteps << " pasos\n";
+    std::cout << "Throughput de saturación: " << bestDelivered << " kbps (con " << bestRate / 1000.0 << " kbps por flujo)\n";
+    if (failed > 0) NS_LOG_UNCOND("Saturación: " << failed << " ejecuciones terminaron con error (ver " << dir << "/*.log)");
+    NS_LOG_UNCOND("Resumen de la búsqueda: " << dir << "/saturation.csv");
+    return failed > 0 ? 1 : 0;
+}
+
+// ----- Benchmark suite -----
+// Fixed-seed reference scenarios run as child processes. Wall time and events/s track the
+// simulator's speed; PDR, throughput and connectivity are compared against a golden CSV
+// (scenario,metric,value) so an optimization that changes results is caught, not just timed.
+
+struct BenchmarkScenario {
+    std::string name;
+    uint32_t clusters;
+    uint32_t nodesPerCluster;
+    double simTime;
+    std::string traffic;
+    uint32_t trafficK;
 };
 
-ConnectivityMetrics globalConnectivity;
+static const std::vector<BenchmarkScenario> kBenchmarkScenarios = {
+    {"small", 2, 4, 60.0, "full", 1},       // ~10 nodes
+    {"medium", 10, 19, 30.0, "nearest", 2}, // ~200 nodes
+    {"large", 40, 49, 20.0, "nearest", 1},  // ~2000 nodes
+};
 
-// --- Crear directorio de salida junto al .cc (similar a manet-proyect-batman.cc) ---
-static std::string
-CreateOutputDirectory (const std::string &suffix = "")
+// Allowed drift of a golden metric: PDR in percentage points, throughput relative,
+// connectivity/attachment percentages absolute
+static bool
+WithinGoldenTolerance (const std::string &metric, double golden, double value)
 {
-    std::string sourceFile = __FILE__;
-    size_t lastSlash = sourceFile.find_last_of("/\\");
-    std::string sourceDir = (lastSlash != std::string::npos) ? sourceFile.substr(0, lastSlash) : ".";
-    std::string outDir = sourceDir + "/manet-jerarquica";
-    if (!suffix.empty()) outDir += "-" + suffix;
-    std::string mkdirCmd = "mkdir -p " + outDir;
-    (void)system(mkdirCmd.c_str());
-    NS_LOG_UNCOND("Directorio de salida: " << outDir);
-    return outDir;
+    auto endsWith = [&metric] (const std::string &s) {
+        return metric.size() >= s.size() && metric.compare(metric.size() - s.size(), s.size(), s) == 0;
+    };
+    if (endsWith("Pdr") || metric == "pdr") return std::fabs(value - golden) <= 1.0;
+    if (endsWith("ThroughputKbps") || metric == "throughputKbps") return std::fabs(value - golden) <= 0.02 * std::max(std::fabs(golden), 1.0);
+    return std::fabs(value - golden) <= 0.5;
 }
 
-// ----- Custom mobility model for leaders -----
-class LeaderTrajectoryMobilityModel : public MobilityModel
+static bool
+IsGoldenMetric (const std::string &metric)
 {
-public:
-    static TypeId GetTypeId()
+    return metric == "leaderConnectivity" || metric == "subordinateAttachment" ||
+           metric.find("Pdr") != std::string::npos || metric == "pdr" ||
+           metric.find("ThroughputKbps") != std::string::npos;
+}
+
+static int
+RunBenchmark (const SimulationParams &base, const std::string &scenarios, uint32_t repeat,
+              const std::string &goldenFile, bool updateGolden, const std::string &program, const std::string &outDir)
+{
+    std::string dir = outDir + "/benchmark";
+    mkdir(dir.c_str(), 0755);
+    repeat = std::max(1u, repeat);
+
+    std::map<std::string, double> golden; // "scenario/metric" -> value
+    bool haveGolden = false;
     {
-        static TypeId tid = TypeId("LeaderTrajectoryMobilityModel")
-            .SetParent<MobilityModel>()
-            .SetGroupName("Mobility")
-            .AddConstructor<LeaderTrajectoryMobilityModel>();
-        return tid;
+        std::ifstream is(goldenFile.c_str());
+        std::string line;
+        while (std::getline(is, line)) {
+            std::vector<std::string> f;
+            std::stringstream ss(line);
+            std::string item;
+            while (std::getline(ss, item, ',')) f.push_back(item);
+            if (f.size() != 3 || f[0] == "scenario") continue;
+            golden[f[0] + "/" + f[1]] = std::atof(f[2].c_str());
+            haveGolden = true;
+        }
+    }
+
+    if (!haveGolden && !updateGolden) {
+        // No golden file is versioned yet: fail before running anything and say how to create one
+        NS_LOG_UNCOND("Benchmark: no existe la referencia " << goldenFile << " o no contiene métricas; no hay con qué comparar.\n"
+                      << "  Genérela una vez con --benchmark=1 --updateGolden=1 (idealmente desde el commit previo a los cambios\n"
+                      << "  que se quieren validar), versione el archivo y repita la ejecución, o indique otra con --goldenFile.");
+        return 1;
+    }
+
+    std::ofstream csv((dir + "/benchmark.csv").c_str());
+    csv << "scenario,nodes,runs,wallMin,wallMean,wallCi95,eventsPerSecond,peakRssMb,goldenChecked,goldenFailed\n";
+    std::vector<std::tuple<std::string, std::string, double>> newGolden;
+    uint32_t failedRuns = 0, failedChecks = 0;
+    std::cout << "\n--- Benchmark (" << repeat << " repeticiones, semilla fija) ---\n";
+
+    for (const std::string &name : SplitList(scenarios)) {
+        auto it = std::find_if(kBenchmarkScenarios.begin(), kBenchmarkScenarios.end(),
+                               [&name] (const BenchmarkScenario &s) { return s.name == name; });
+        if (it == kBenchmarkScenarios.end()) {
+            NS_LOG_UNCOND("Benchmark: escenario desconocido '" << name << "'");
+            failedRuns++;
+            continue;
+        }
+        SimulationParams p = base;
+        p.numClusters = it->clusters;
+        p.nodesPerCluster = it->nodesPerCluster;
+        p.simulationTime = it->simTime;
+        p.traffic = it->traffic;
+        p.trafficK = it->trafficK;
+        p.layout = "grid";
+        p.trajectory.clear();
+        p.trajectoryMix = "circular,linear,rectangular,zigzag";
+        p.replayMobility.clear();
+        p.rngRun = 1;
+        p.summaryFlows = true;
+
+        std::vector<double> walls, eventRates, rss;
+        RunSummary last;
+        bool haveLast = false;
+        for (uint32_t r=0;r<repeat;++r) {
+            std::string stem = dir + "/" + name + "-" + std::to_string(r);
+            std::vector<std::string> args = ScenarioArgs(p);
+            args.push_back("--anim=0");
+            args.push_back("--outputs=none");
+            args.push_back("--summaryFile=" + stem + ".csv");
+            // Sequential on purpose: concurrent runs would skew each other's timings
+            pid_t pid = LaunchRun(program, args, stem + ".log");
+            int status = 0;
+            struct rusage ru;
+            if (pid < 0 || wait4(pid, &status, 0, &ru) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                NS_LOG_UNCOND("Benchmark: " << name << " repetición " << r << " falló (ver " << stem << ".log)");
+                failedRuns++;
+                continue;
+            }
+            RunSummary s;
+            if (!ReadRunSummary(stem + ".csv", s)) { failedRuns++; continue; }
+            double events = 0.0, runSeconds = 0.0, wall = 0.0;
+            for (auto const &m : s.metrics) {
+                if (m.first == "events") events = m.second;
+                else if (m.first == "runSeconds") runSeconds = m.second;
+                else if (m.first == "wallSeconds") wall = m.second;
+            }
+            walls.push_back(wall);
+            if (runSeconds > 0) eventRates.push_back(events / runSeconds);
+            rss.push_back(ru.ru_maxrss / 1024.0); // ru_maxrss is in KiB on Linux
+            last = s;
+            haveLast = true;
+        }
+        if (!haveLast) continue;
+
+        double wallMean, wallHw, rateMean, rateHw;
+        MeanConfidence(walls, wallMean, wallHw);
+        MeanConfidence(eventRates, rateMean, rateHw);
+        double wallMin = *std::min_element(walls.begin(), walls.end());
+        double peakRss = *std::max_element(rss.begin(), rss.end());
+        uint32_t nodes = it->clusters * (it->nodesPerCluster + 1);
+
+        // Metrics do not depend on the repetition (same seed), so the last run is checked
+        uint32_t checked = 0, failed = 0;
+        std::set<std::string> seen;
+        for (auto const &m : last.metrics) {
+            if (!IsGoldenMetric(m.first)) continue;
+            newGolden.emplace_back(name, m.first, m.second);
+            seen.insert(m.first);
+            auto g = golden.find(name + "/" + m.first);
+            if (updateGolden || g == golden.end()) continue;
+            checked++;
+            if (!WithinGoldenTolerance(m.first, g->second, m.second)) {
+                failed++;
+                std::cout << "  REGRESIÓN " << name << "/" << m.first << ": referencia " << g->second << ", obtenido " << m.second << "\n";
+            }
+        }
+        if (!updateGolden) {
+            // Reference metrics the run no longer produces (e.g. a flow that vanished) also fail
+            std::string prefix = name + "/";
+            for (auto const &g : golden) {
+                if (g.first.compare(0, prefix.size(), prefix) != 0 || seen.count(g.first.substr(prefix.size()))) continue;
+                checked++;
+                failed++;
+                std::cout << "  REGRESIÓN " << g.first << ": métrica ausente en la ejecución\n";
+            }
+            if (checked == 0) {
+                failedChecks++;
+                std::cout << "  " << name << ": sin referencia en " << goldenFile << "\n";
+            }
+        }
+        failedChecks += failed;
+
+        std::cout << name << " (" << nodes << " nodos): pared min " << wallMin << " s, media " << wallMean << " ± " << wallHw
+                  << " s, " << rateMean << " eventos/s, memoria pico " << peakRss << " MB";
+        if (updateGolden) std::cout << ", referencia actualizada\n";
+        else std::cout << ", " << checked - failed << "/" << checked << " métricas dentro de tolerancia\n";
+        csv << name << "," << nodes << "," << walls.size() << "," << wallMin << "," << wallMean << "," << wallHw << ","
+            << rateMean << "," << peakRss << "," << checked << "," << failed << "\n";
     }
 
-    LeaderTrajectoryMobilityModel() : m_trajectoryType("circular"), m_speed(5.0), m_currentWaypoint(0)
+    if (updateGolden) {
+        std::ofstream os(goldenFile.c_str());
+        os << "scenario,metric,value\n";
+        for (auto const &g : newGolden) os << std::get<0>(g) << "," << std::get<1>(g) << "," << std::get<2>(g) << "\n";
+        NS_LOG_UNCOND("Referencia escrita: " << goldenFile << " (" << newGolden.size() << " métricas)");
+    }
+    NS_LOG_UNCOND("Resumen del benchmark: " << dir << "/benchmark.csv");
+    return (failedRuns > 0 || failedChecks > 0) ? 1 : 0;
+}
+
+// ----- Steady-state detection -----
+// Online MSER-5 truncation plus batch means over the per-window series. Each series drops the
+// windows before minWarmup (traffic start), then MSER-5 picks the truncation point that
+// minimises the standard error of the remaining 5-window batch averages; the rest is split
+// into `batches` batches whose means give a 95% CI. When every series with samples has
+// half-width <= precision * |mean| the detector calls Simulator::Stop().
+class SteadyStateDetector
+{
+public:
+    struct Estimate {
+        std::string name;
+        double mean = 0.0, halfWidth = 0.0;
+        double warmup = 0.0;   // end of the truncated prefix (s)
+        uint32_t samples = 0;  // windows kept after truncation
+        bool ready = false;    // truncation accepted and enough samples for the batches
+    };
+
+    SteadyStateDetector(const std::vector<std::string> &series, double precision, double minWarmup, uint32_t batches)
+        : m_precision(precision), m_minWarmup(minWarmup), m_batches(std::max(2u, batches)),
+          m_converged(false), m_stopTime(0.0), m_series(series.size())
     {
-        m_position = Vector(0,0,0);
-        m_velocity = Vector(0,0,0);
+        for (uint32_t k=0;k<series.size();++k) m_series[k].estimate.name = series[k];
     }
 
-    void SetTrajectory(const std::string &type, const Vector &center, double radius, double speed)
+    // One value per series for the window ending at t; NaN = no sample in this window
+    void Observe(double t, const std::vector<double> &values)
     {
-        m_trajectoryType = type;
-        m_center = center;
-        m_radius = radius;
-        m_speed = speed;
-        m_position = center;
-        GenerateWaypoints();
-        if (!m_waypoints.empty()) {
-            m_position = m_waypoints[0];
-            ScheduleNextWaypoint();
+        if (m_converged || t <= m_minWarmup + 1e-9) return;
+        for (uint32_t k=0;k<m_series.size() && k<values.size();++k) {
+            if (std::isnan(values[k])) continue;
+            m_series[k].t.push_back(t);
+            m_series[k].x.push_back(values[k]);
+        }
+        bool all = true, any = false;
+        for (Series &s : m_series) {
+            if (s.x.empty()) continue;
+            any = true;
+            Evaluate(s);
+            Estimate &e = s.estimate;
+            if (!e.ready || e.halfWidth > m_precision * std::fabs(e.mean) + 1e-12) all = false;
+        }
+        if (any && all) {
+            m_converged = true;
+            m_stopTime = t;
+            NS_LOG_UNCOND("Estado estacionario alcanzado en t=" << t << " s (precisión " << m_precision * 100.0 << "%)");
+            Simulator::Stop();
         }
     }
 
-    virtual Ptr<MobilityModel> Copy() const override {
-        Ptr<LeaderTrajectoryMobilityModel> copy = CreateObject<LeaderTrajectoryMobilityModel>();
-        copy->m_trajectoryType = m_trajectoryType;
-        copy->m_center = m_center;
-        copy->m_radius = m_radius;
-        copy->m_speed = m_speed;
-        copy->m_position = m_position;
-        copy->m_velocity = m_velocity;
-        copy->m_waypoints = m_waypoints;
-        copy->m_currentWaypoint = m_currentWaypoint;
-        return copy;
+    bool Converged() const { return m_converged; }
+    double GetStopTime() const { return m_stopTime; }
+
+    // Largest truncation point over the series that have samples
+    double GetWarmup() const
+    {
+        double w = m_minWarmup;
+        for (const Series &s : m_series) if (!s.x.empty()) w = std::max(w, s.estimate.warmup);
+        return w;
     }
 
-private:
-    void GenerateWaypoints()
+    std::vector<Estimate> GetEstimates() const
     {
-        m_waypoints.clear();
-        if (m_trajectoryType == "circular") {
-            int n = 12;
-            for (int i=0;i<n;i++) {
-                double ang = 2.0*M_PI*i/n;
-                m_waypoints.push_back(Vector(m_center.x + m_radius*cos(ang),
-                                             m_center.y + m_radius*sin(ang), 0.0));
-            }
-        } else if (m_trajectoryType == "linear") {
-            m_waypoints.push_back(Vector(m_center.x - m_radius, m_center.y, 0));
-            m_waypoints.push_back(Vector(m_center.x + m_radius, m_center.y, 0));
-        } else if (m_trajectoryType == "rectangular") {
-            double h = m_radius * 0.7;
-            m_waypoints.push_back(Vector(m_center.x - h, m_center.y - h, 0));
-            m_waypoints.push_back(Vector(m_center.x + h, m_center.y - h, 0));
-            m_waypoints.push_back(Vector(m_center.x + h, m_center.y + h, 0));
-            m_waypoints.push_back(Vector(m_center.x - h, m_center.y + h, 0));
-        } else { // zigzag default
-            int seg = 4;
-            double seglen = (2.0*m_radius)/seg;
-            for (int i=0;i<=seg;i++) {
-                double x = m_center.x - m_radius + i*seglen;
-                double y = m_center.y + ((i%2==0)? -m_radius*0.3 : m_radius*0.3);
-                m_waypoints.push_back(Vector(x,y,0));
-            }
-        }
+        std::vector<Estimate> out;
+        for (const Series &s : m_series) out.push_back(s.estimate);
+        return out;
     }
 
-    void ScheduleNextWaypoint()
+    void Print(std::ostream &os) const
     {
-        if (m_waypoints.empty()) return;
-        Vector next = m_waypoints[m_currentWaypoint];
-        double dist = CalculateDistance(m_position, next);
-        double t = dist / m_speed;
-        if (t > 0) {
-            m_velocity.x = (next.x - m_position.x)/t;
-            m_velocity.y = (next.y - m_position.y)/t;
-            Simulator::Schedule(Seconds(t), &LeaderTrajectoryMobilityModel::ReachWaypoint, this);
+        os << "Estado estacionario: " << (m_converged ? "alcanzado" : "no alcanzado")
+           << "  calentamiento: " << GetWarmup() << " s";
+        if (m_converged) os << "  detenido en: " << m_stopTime << " s";
+        os << "\n";
+        for (const Series &s : m_series) {
+            const Estimate &e = s.estimate;
+            if (s.x.empty()) continue;
+            os << "  " << e.name << ": " << e.mean << " ± " << e.halfWidth << " (" << e.samples << " ventanas"
+               << (e.ready ? "" : ", insuficiente") << ")\n";
         }
     }
 
-    void ReachWaypoint()
+private:
+    static constexpr uint32_t kMserBatch = 5;
+
+    struct Series {
+        std::vector<double> t, x;
+        Estimate estimate;
+    };
+
+    void Evaluate(Series &s)
     {
-        m_position = m_waypoints[m_currentWaypoint];
-        m_currentWaypoint = (m_currentWaypoint + 1) % m_waypoints.size();
-        NotifyCourseChange();
-        ScheduleNextWaypoint();
-    }
+        Estimate &e = s.estimate;
+        e.ready = false;
+        uint32_t m = s.x.size() / kMserBatch;
+        if (m < 2) return;
+        // MSER is unreliable on short series: wait for one MSER batch per batch mean
+        bool enough = m >= m_batches;
+        // MSER-5 over the batch averages, with suffix sums so every truncation point is O(1)
+        std::vector<double> z(m);
+        for (uint32_t b=0;b<m;++b) {
+            double sum = 0.0;
+            for (uint32_t i=0;i<kMserBatch;++i) sum += s.x[b*kMserBatch + i];
+            z[b] = sum / kMserBatch;
+        }
+        double sum = 0.0, sumSq = 0.0, best = std::numeric_limits<double>::infinity();
+        uint32_t bestD = 0;
+        std::vector<double> mser(m);
+        for (uint32_t d=m;d-- > 0;) {
+            sum += z[d]; sumSq += z[d]*z[d];
+            uint32_t n = m - d;
+            mser[d] = (sumSq - sum*sum/n) / ((double)n*n);
+        }
+        for (uint32_t d=0;d<=m/2;++d) {
+            if (mser[d] < best) { best = mser[d]; bestD = d; }
+        }
+        uint32_t first = bestD * kMserBatch;
+        e.warmup = first > 0 ? s.t[first - 1] : m_minWarmup;
+        e.samples = s.x.size() - first;
 
-    virtual Vector DoGetPosition() const override { return m_position; }
-    virtual void DoSetPosition(const Vector &position) override { m_position = position; NotifyCourseChange(); }
-    virtual Vector DoGetVelocity() const override { return m_velocity; }
+        // Batch means on the kept windows (at least two per batch); a leftover that does not
+        // fill a batch is dropped from the front, which keeps the most recent windows
+        uint32_t size = e.samples / m_batches;
+        if (size < 2) {
+            MeanConfidence(std::vector<double>(s.x.begin() + first, s.x.end()), e.mean, e.halfWidth);
+            return;
+        }
+        uint32_t start = s.x.size() - size * m_batches;
+        std::vector<double> y(m_batches, 0.0);
+        for (uint32_t i=start;i<s.x.size();++i) y[(i - start) / size] += s.x[i];
+        for (double &v : y) v /= size;
+        MeanConfidence(y, e.mean, e.halfWidth);
+        // The truncation is trusted only while it stays in the first half of the data
+        e.ready = enough && bestD < m/2;
+    }
 
-    Vector m_position;
-    Vector m_velocity;
-    Vector m_center;
-    double m_radius;
-    std::string m_trajectoryType;
-    double m_speed;
-    std::vector<Vector> m_waypoints;
-    uint32_t m_currentWaypoint;
+    double m_precision;
+    double m_minWarmup;
+    uint32_t m_batches;
+    bool m_converged;
+    double m_stopTime;
+    std::vector<Series> m_series;
 };
 
-NS_OBJECT_ENSURE_REGISTERED(LeaderTrajectoryMobilityModel);
+// ----- Scenario generator -----
+// Builds params.clusters procedurally so the scenario scales past the three hand-written
+// clusters. Centers go on a grid, uniformly at random with a minimum separation ("random")
+// or as a plain Poisson point pattern ("poisson"); sizes come from a distribution spec and
+// trajectories from a weighted mix.
 
-// ----- Helper functions -----
-void SetupLeaderMobility(NodeContainer &leaders, const std::vector<ClusterConfig> &clusters, double speed)
+// "fixed:N", "uniform:MIN:MAX" or "poisson:MEAN" (at least one subordinate per cluster)
+static uint32_t
+DrawClusterSize (const std::string &spec, Ptr<UniformRandomVariable> ur)
 {
-    for (uint32_t i=0;i<leaders.GetN();++i) {
-        Ptr<Node> n = leaders.Get(i);
-        Ptr<LeaderTrajectoryMobilityModel> model = CreateObject<LeaderTrajectoryMobilityModel>();
-        uint32_t idx = i % clusters.size();
-        model->SetTrajectory(clusters[idx].trajectoryType, clusters[idx].leaderStartPos, clusters[idx].mobilityRadius, speed);
-        n->AggregateObject(model);
+    std::vector<std::string> f;
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ':')) f.push_back(item);
+    if (f.size() >= 3 && f[0] == "uniform") {
+        return std::max(1u, ur->GetInteger(std::atoi(f[1].c_str()), std::atoi(f[2].c_str())));
     }
-    NS_LOG_INFO("SetupLeaderMobility: líderes configurados");
+    if (f.size() >= 2 && f[0] == "poisson") {
+        // Knuth's method; cluster means are small
+        double limit = std::exp(-std::atof(f[1].c_str())), p = 1.0;
+        uint32_t k = 0;
+        do { k++; p *= ur->GetValue(0, 1); } while (p > limit);
+        return std::max(1u, k - 1);
+    }
+    return std::max(1, std::atoi(f.size() >= 2 ? f[1].c_str() : f[0].c_str()));
 }
 
-bool CheckConnectivity(Ptr<Node> a, Ptr<Node> b, double maxRange)
+// Weighted pick from "circular:2,zigzag:1" (weights default to 1)
+static std::string
+DrawTrajectory (const std::string &mix, Ptr<UniformRandomVariable> ur)
 {
-    Ptr<MobilityModel> ma = a->GetObject<MobilityModel>();
-    Ptr<MobilityModel> mb = b->GetObject<MobilityModel>();
-    if (!ma || !mb) return false;
-    return CalculateDistance(ma->GetPosition(), mb->GetPosition()) <= maxRange;
+    std::vector<std::pair<std::string, double>> entries;
+    double total = 0.0;
+    for (const std::string &e : SplitList(mix)) {
+        size_t colon = e.find(':');
+        double w = colon == std::string::npos ? 1.0 : std::atof(e.substr(colon + 1).c_str());
+        entries.push_back({e.substr(0, colon), w});
+        total += w;
+    }
+    if (entries.empty()) return "circular";
+    double r = ur->GetValue(0, total);
+    for (auto const &e : entries) {
+        if (r < e.second) return e.first;
+        r -= e.second;
+    }
+    return entries.back().first;
 }
 
-void MonitorSecondLevelClusterConnectivity(NodeContainer leaders, double maxRange)
+static void
+GenerateClusters (SimulationParams &params)
 {
-    globalConnectivity.totalChecks++;
-    uint32_t connectedPairs = 0;
-    uint32_t totalPairs = 0;
-    for (uint32_t i=0;i<leaders.GetN();++i) {
-        for (uint32_t j=i+1;j<leaders.GetN();++j) {
-            totalPairs++;
-            std::pair<uint32_t,uint32_t> key(i,j);
-            if (CheckConnectivity(leaders.Get(i), leaders.Get(j), maxRange)) {
-                connectedPairs++;
-                globalConnectivity.pairConnectivity[key]++;
+    Ptr<UniformRandomVariable> ur = CreateObject<UniformRandomVariable>();
+    double d = params.interClusterDistance;
+    uint32_t n = params.numClusters;
+    uint32_t side = (uint32_t)std::ceil(std::sqrt((double)n));
+    double area = d * side;
+    std::vector<Vector> centers;
+    for (uint32_t i=0;i<n;++i) {
+        Vector c;
+        if (params.layout == "random" || params.layout == "poisson") {
+            // "random" rejects centers closer than d/2 to an existing one (hard-core process)
+            double minSep2 = params.layout == "random" ? 0.25*d*d : 0.0;
+            for (uint32_t attempt=0; attempt<100; ++attempt) {
+                c = Vector(ur->GetValue(0, area), ur->GetValue(0, area), 0);
+                bool ok = true;
+                for (const Vector &o : centers) {
+                    if (CalculateDistanceSquared(o, c) < minSep2) { ok = false; break; }
+                }
+                if (ok) break;
             }
+        } else { // grid
+            c = Vector(0.75*d + (i % side)*d, 0.75*d + (i / side)*d, 0);
         }
+        centers.push_back(c);
     }
-    if (totalPairs>0 && (double)connectedPairs/totalPairs >= 0.5) globalConnectivity.connectedChecks++;
-}
-
-void ScheduleConnectivityMonitoring(NodeContainer leaders, double interval, double totalTime, double maxRange)
-{
-    for (double t=0.0; t<=totalTime; t+=interval) {
-        Simulator::Schedule(Seconds(t), &MonitorSecondLevelClusterConnectivity, leaders, maxRange);
+    params.clusters.clear();
+    for (uint32_t i=0;i<n;++i) {
+        // A /24 cluster subnet holds the leader plus at most 252 subordinates
+        params.clusters.push_back({i+1, centers[i], std::min(252u, DrawClusterSize(params.clusterSize, ur)),
+                                   0.2*d*ur->GetValue(0.8, 1.25), ur->GetValue(2.0, 3.0),
+                                   DrawTrajectory(params.trajectoryMix, ur)});
     }
+    NS_LOG_INFO("GenerateClusters: " << n << " clusters (layout=" << params.layout << ", tamaño=" << params.clusterSize << ")");
 }
 
-// Subordinate mobility: RandomWalk centered near leader initially
-void SetupSubordinateMobility(NodeContainer &subs, Ptr<Node> leader, double radius, double speed)
+// 10.x.y.0/24 per cluster: 10.(i+1).0.0 for the first 254 clusters, then the third octet grows
+static std::string
+ClusterSubnet (uint32_t i)
 {
-    MobilityHelper mh;
-    Ptr<MobilityModel> lm = leader->GetObject<MobilityModel>();
-    Vector center = lm ? lm->GetPosition() : Vector(0,0,0);
-
-    Ptr<ListPositionAllocator> pos = CreateObject<ListPositionAllocator>();
-    Ptr<UniformRandomVariable> ur = CreateObject<UniformRandomVariable>();
-    for (uint32_t i=0;i<subs.GetN();++i) {
-        double x = center.x + ur->GetValue(-radius*0.5, radius*0.5);
-        double y = center.y + ur->GetValue(-radius*0.5, radius*0.5);
-        pos->Add(Vector(x,y,0));
-    }
-    mh.SetPositionAllocator(pos);
-    mh.SetMobilityModel("ns3::RandomWalk2dMobilityModel",
-                        "Bounds", RectangleValue(Rectangle(center.x - radius, center.x + radius,
-                                                          center.y - radius, center.y + radius)),
-                        "Distance", DoubleValue(radius*0.2),
-                        "Speed", StringValue("ns3::ConstantRandomVariable[Constant=" + std::to_string(speed) + "]"));
-    mh.Install(subs);
-    NS_LOG_INFO("SetupSubordinateMobility: " << subs.GetN() << " subordinados (radio=" << radius << ", speed=" << speed << ")");
+    return "10." + std::to_string(i % 254 + 1) + "." + std::to_string(i / 254) + ".0";
 }
 
-// Reposition subordinate nodes periodically around their leader so cluster moves with leader
-void RepositionSubordinates(NodeContainer subs, Ptr<Node> leader, double radius)
+// ----- Traffic matrices -----
+// Directed leader-to-leader flow lists. Only "full" is quadratic in the number of leaders;
+// the sparse matrices produce O(numClusters * k) flows.
+//   full     every pair i -> j with i < j (original behaviour)
+//   nearest  each leader -> its k nearest leaders
+//   gravity  each leader -> k leaders drawn with weight size_i*size_j/d^2
+//   random   each leader -> k distinct random leaders
+//   hotspot  every leader -> the k leaders closest to the centroid
+static std::vector<std::pair<uint32_t, uint32_t>>
+BuildTrafficMatrix (const std::vector<ClusterConfig> &clusters, uint32_t n, const std::string &type, uint32_t k)
 {
-    Ptr<MobilityModel> lm = leader->GetObject<MobilityModel>();
-    Vector lp = lm ? lm->GetPosition() : Vector(0,0,0);
+    std::vector<std::pair<uint32_t, uint32_t>> flows;
+    if (n < 2) return flows;
+    k = std::min(k, n - 1);
+    if (k == 0 && type != "full") return flows;
     Ptr<UniformRandomVariable> ur = CreateObject<UniformRandomVariable>();
-    for (uint32_t i=0;i<subs.GetN();++i) {
-        Ptr<Node> s = subs.Get(i);
-        Ptr<MobilityModel> sm = s->GetObject<MobilityModel>();
-        if (!sm) continue;
-        double ang = ur->GetValue(0, 2*M_PI);
-        double r = ur->GetValue(0, radius*0.8);
-        sm->SetPosition(Vector(lp.x + r*cos(ang), lp.y + r*sin(ang), 0));
+    auto dist2 = [&](uint32_t a, uint32_t b) { return CalculateDistanceSquared(clusters[a].leaderStartPos, clusters[b].leaderStartPos); };
+    std::vector<uint32_t> idx;
+    if (type == "nearest") {
+        for (uint32_t i=0;i<n;++i) {
+            idx.clear();
+            for (uint32_t j=0;j<n;++j) if (j != i) idx.push_back(j);
+            std::nth_element(idx.begin(), idx.begin() + (k - 1), idx.end(), [&](uint32_t a, uint32_t b) { return dist2(i, a) < dist2(i, b); });
+            for (uint32_t m=0;m<k;++m) flows.push_back({i, idx[m]});
+        }
+    } else if (type == "gravity") {
+        std::vector<double> cum(n);
+        for (uint32_t i=0;i<n;++i) {
+            std::vector<bool> taken(n, false);
+            taken[i] = true;
+            for (uint32_t m=0;m<k;++m) {
+                double total = 0.0;
+                for (uint32_t j=0;j<n;++j) {
+                    if (!taken[j]) total += (double)clusters[i].numNodes*clusters[j].numNodes / std::max(dist2(i, j), 1.0);
+                    cum[j] = total;
+                }
+                uint32_t j = std::lower_bound(cum.begin(), cum.end(), ur->GetValue(0, total)) - cum.begin();
+                j = std::min(j, n - 1);
+                while (taken[j]) j = (j + 1) % n;
+                taken[j] = true;
+                flows.push_back({i, j});
+            }
+        }
+    } else if (type == "random") {
+        for (uint32_t i=0;i<n;++i) {
+            std::vector<uint32_t> chosen;
+            while (chosen.size() < k) {
+                uint32_t j = ur->GetInteger(0, n - 1);
+                if (j == i || std::find(chosen.begin(), chosen.end(), j) != chosen.end()) continue;
+                chosen.push_back(j);
+                flows.push_back({i, j});
+            }
+        }
+    } else if (type == "hotspot") {
+        Vector centroid(0,0,0);
+        for (uint32_t i=0;i<n;++i) { centroid.x += clusters[i].leaderStartPos.x / n; centroid.y += clusters[i].leaderStartPos.y / n; }
+        for (uint32_t j=0;j<n;++j) idx.push_back(j);
+        std::partial_sort(idx.begin(), idx.begin() + k, idx.end(), [&](uint32_t a, uint32_t b) {
+            return CalculateDistanceSquared(clusters[a].leaderStartPos, centroid) < CalculateDistanceSquared(clusters[b].leaderStartPos, centroid);
+        });
+        for (uint32_t i=0;i<n;++i) {
+            for (uint32_t m=0;m<k;++m) if (idx[m] != i) flows.push_back({i, idx[m]});
+        }
+    } else { // full
+        for (uint32_t i=0;i<n;++i)
+            for (uint32_t j=i+1;j<n;++j) flows.push_back({i, j});
     }
-    Simulator::Schedule(Seconds(1.0), &RepositionSubordinates, subs, leader, radius);
+    return flows;
 }
 
-// Inter-cluster traffic between leaders (backhaul IPs)
-void SetupInterClusterTraffic(NodeContainer &leaders, Ipv4InterfaceContainer &leaderBackhaulIfaces, double startTime, double stopTime)
+// ----- Fork-after-setup replication -----
+// The topology (nodes, devices, stacks, routes, applications) is built once; right before
+// Simulator::Run the process forks one child per replica, at most `jobs` alive at a time.
+// Children share the setup through copy-on-write pages and only reseed their random streams.
+// Returns the replica index in a child, or -1 in the parent once every child has exited and
+// the per-replica summaries have been aggregated into dir/fork-summary.csv; failed is then
+// the number of replicas that could not be forked or did not exit with status 0.
+static int32_t
+ForkReplicas (uint32_t count, uint32_t jobs, const std::string &dir, uint32_t &failed)
 {
-    if (leaders.GetN() < 2) return;
-    uint32_t port = 9000;
-    for (uint32_t i=0;i<leaders.GetN();++i) {
-        for (uint32_t j=i+1;j<leaders.GetN();++j) {
-            Ipv4Address dst = leaderBackhaulIfaces.GetAddress(j);
-            OnOffHelper on("ns3::UdpSocketFactory", InetSocketAddress(dst, port + i*10 + j));
-            on.SetConstantRate(DataRate("30kbps"));
-            on.SetAttribute("PacketSize", UintegerValue(512));
-            ApplicationContainer apps = on.Install(leaders.Get(i));
-            apps.Start(Seconds(startTime + i*0.5));
-            apps.Stop(Seconds(stopTime));
-            PacketSinkHelper sink("ns3::UdpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), port + i*10 + j));
-            apps = sink.Install(leaders.Get(j));
-            apps.Start(Seconds(startTime));
-            apps.Stop(Seconds(stopTime));
+    mkdir(dir.c_str(), 0755);
+    if (jobs == 0) jobs = std::max(1u, std::thread::hardware_concurrency());
+    std::cout.flush();
+    std::vector<std::string> summaries;
+    uint32_t running = 0;
+    failed = 0;
+    for (uint32_t k=0;k<count;++k) {
+        int status = 0;
+        if (running >= jobs && waitpid(-1, &status, 0) > 0) {
+            running--;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+        }
+        std::string stem = dir + "/run-" + std::to_string(k);
+        summaries.push_back(stem + ".csv");
+        pid_t pid = fork();
+        if (pid == 0) {
+            int fd = open((stem + ".log").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd >= 0) { dup2(fd, STDOUT_FILENO); dup2(fd, STDERR_FILENO); close(fd); }
+            return k;
         }
+        if (pid < 0) failed++;
+        else running++;
     }
-    NS_LOG_INFO("SetupInterClusterTraffic: tráfico entre líderes configurado");
+    int status = 0;
+    while (running > 0 && waitpid(-1, &status, 0) > 0) {
+        running--;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+    }
+    if (failed > 0) NS_LOG_UNCOND("Réplicas: " << failed << " terminaron con error (ver " << dir << "/*.log)");
+    AggregateRunSummaries(summaries, dir + "/fork-summary.csv", std::cout);
+    return -1;
 }
 
 // ------------------- main -------------------
@@ -301,6 +4387,59 @@ int main(int argc, char *argv[])
     params.simulationTime = 60.0;
     params.leaderSpeed = 8.0; // speed for leaders (patrolling)
     params.interClusterDistance = 200.0;
+    params.backhaulRange = 300.0;
+    params.accessRange = 100.0;
+    params.monitorInterval = 1.0;
+    params.connectivityMode = "poll";
+    params.nodesPerCluster = 0;
+    params.trajectory = "";
+    params.rngRun = 0;
+    params.enableAnim = true;
+    params.summaryFile = "";
+    params.forkReplications = 0;
+    params.layout = "manual";
+    params.clusterSize = "fixed:3";
+    params.trajectoryMix = "circular,rectangular,zigzag";
+    params.traffic = "full";
+    params.trafficK = 2;
+    params.flowRate = "30kbps";
+    params.trafficProfile = "onoff";
+    params.trafficEndpoints = "leader";
+    params.burstOn = 0.5;
+    params.burstOff = 0.5;
+    params.traceMode = "netanim";
+    params.traceMinMove = 1.0;
+    params.outputs = "report,windows";
+    params.metricsWindow = 1.0;
+    params.graphAnalytics = false;
+    params.steadyState = false;
+    params.steadyPrecision = 0.05;
+    params.steadyWarmup = 5.0;    // traffic start; OLSR converges before it
+    params.steadyBatches = 10;
+    params.channel = "yans";
+    params.cullThreshold = "sensitivity";
+    params.linkMode = "wifi";
+    params.fastRate = "6Mbps";
+    params.fastLoss = 0.0;
+    params.routing = "flat";
+    params.profile = false;
+    params.summaryFlows = false;
+    bool benchmarkMode = false;
+    bool updateGolden = false;
+    uint32_t benchmarkRepeat = 3;
+    std::string benchmarkScenarios = "small,medium,large";
+    std::string goldenFile;                    // empty = benchmark-golden.csv next to the .cc
+    bool validateFastMode = false;
+    uint32_t oracleSelfTest = 0;
+    bool saturationSearch = false;
+    double saturationPdr = 90.0;
+    params.asyncOutput = true;
+    params.compressOutput = false;
+    std::string convertTrace;
+    bool sweepMode = false;
+    SweepConfig sweep;
+    sweep.replications = 1;
+    sweep.jobs = 0;
 
     // Configure clusters (you can adjust)
     params.clusters.push_back({1, Vector(150,150,0), 4, 50.0, 3.0, "circular"});
@@ -311,12 +4450,109 @@ int main(int argc, char *argv[])
     cmd.AddValue("numClusters", "Número de clusters (>=2)", params.numClusters);
     cmd.AddValue("simTime", "Tiempo de simulación", params.simulationTime);
     cmd.AddValue("leaderSpeed", "Velocidad líderes", params.leaderSpeed);
+    cmd.AddValue("monitorInterval", "Intervalo del monitor de conectividad (s)", params.monitorInterval);
+    cmd.AddValue("backhaulRange", "Alcance líder-líder (m)", params.backhaulRange);
+    cmd.AddValue("accessRange", "Alcance subordinado-líder para el monitor (m)", params.accessRange);
+    cmd.AddValue("connectivityMode", "Monitor de conectividad: poll (muestreo), event (cruces exactos) o both", params.connectivityMode);
+    cmd.AddValue("nodesPerCluster", "Subordinados por cluster (0 = configuración de cada cluster)", params.nodesPerCluster);
+    cmd.AddValue("trajectory", "Trayectoria de todos los líderes (circular, linear, rectangular, zigzag)", params.trajectory);
+    cmd.AddValue("rngRun", "RngRun (réplica); por defecto, el valor global --RngRun", params.rngRun);
+    cmd.AddValue("anim", "Generar trazas NetAnim", params.enableAnim);
+    cmd.AddValue("summaryFile", "Fichero CSV con el resumen de la ejecución", params.summaryFile);
+    cmd.AddValue("interClusterDistance", "Separación entre clusters generados (m)", params.interClusterDistance);
+    cmd.AddValue("layout", "Disposición de clusters: manual (3 fijos), grid, random o poisson", params.layout);
+    cmd.AddValue("clusterSize", "Tamaño de clusters generados: fixed:N, uniform:MIN:MAX o poisson:MEDIA", params.clusterSize);
+    cmd.AddValue("trajectoryMix", "Mezcla de trayectorias de clusters generados (p.ej. circular:2,zigzag:1)", params.trajectoryMix);
+    cmd.AddValue("traffic", "Matriz de tráfico: full, nearest, gravity, random o hotspot", params.traffic);
+    cmd.AddValue("trafficK", "Destinos por líder (nearest/gravity/random) o número de hotspots", params.trafficK);
+    cmd.AddValue("flowRate", "Tasa media de cada flujo", params.flowRate);
+    cmd.AddValue("trafficProfile", "Perfil de carga: onoff (OnOff clásico entre líderes), cbr, poisson, bursty o saturating (motor de tráfico)", params.trafficProfile);
+    cmd.AddValue("trafficEndpoints", "Extremos de los flujos: leader, subordinate o mixed", params.trafficEndpoints);
+    cmd.AddValue("burstOn", "Perfil bursty: duración media de las ráfagas (s)", params.burstOn);
+    cmd.AddValue("burstOff", "Perfil bursty: duración media del silencio (s)", params.burstOff);
+    cmd.AddValue("saturationSearch", "Aumenta la carga ofrecida hasta encontrar el throughput de saturación", saturationSearch);
+    cmd.AddValue("saturationPdr", "Búsqueda de saturación: PDR (%) por debajo del cual la red se considera saturada", saturationPdr);
+    cmd.AddValue("traceMode", "Trazas: netanim (XML completo), compact (binario con deltas) o none", params.traceMode);
+    cmd.AddValue("traceMinMove", "Traza compacta: desplazamiento mínimo entre muestras de posición (m)", params.traceMinMove);
+    cmd.AddValue("outputs", "Salidas habilitadas: report (informe por consola), flows (informe en archivo), windows (métricas por ventana, CSV), graph (serie del grafo de dos niveles con --graphAnalytics, CSV)", params.outputs);
+    cmd.AddValue("metricsWindow", "Ancho de ventana de las métricas por flujo/cluster (s), 0 desactiva", params.metricsWindow);
+    cmd.AddValue("graphAnalytics", "Analítica del grafo de dos niveles: particiones, componente mayor, alcanzabilidad, desconexiones y líderes de articulación", params.graphAnalytics);
+    cmd.AddValue("steadyState", "Detecta el estado estacionario (MSER-5 + medias por lotes) y detiene la simulación al alcanzar la precisión", params.steadyState);
+    cmd.AddValue("steadyPrecision", "Estado estacionario: semiancho relativo del IC 95% exigido (p.ej. 0.05)", params.steadyPrecision);
+    cmd.AddValue("steadyWarmup", "Estado estacionario: calentamiento mínimo descartado (s)", params.steadyWarmup);
+    cmd.AddValue("steadyBatches", "Estado estacionario: número de lotes", params.steadyBatches);
+    cmd.AddValue("asyncOutput", "Escribir las salidas desde un hilo en segundo plano", params.asyncOutput);
+    cmd.AddValue("compressOutput", "Comprimir con gzip las salidas a archivo (traza compacta, informe)", params.compressOutput);
+    cmd.AddValue("channel", "Canal inalámbrico: yans (Friis, entrega a todos), spectrum (SpectrumWifiPhy sin descarte) o culled (spectrum con descarte por alcance)", params.channel);
+    cmd.AddValue("cullThreshold", "Canal culled: potencia mínima en el mejor caso para entregar: sensitivity (RxSensitivity de la PHY), ed (CcaEdThreshold) o un valor en dBm", params.cullThreshold);
+    cmd.AddValue("linkMode", "Capa de enlace: wifi (802.11a completo) o fast (entrega por distancia, sin MAC)", params.linkMode);
+    cmd.AddValue("fastRate", "Modo fast: tasa de los dispositivos", params.fastRate);
+    cmd.AddValue("fastLoss", "Modo fast: probabilidad de pérdida por trama", params.fastLoss);
+    cmd.AddValue("oracleSelfTest", "Autoprueba del enrutamiento oráculo con N líderes (actualización incremental frente a BFS completo) y termina", oracleSelfTest);
+    cmd.AddValue("validateFastMode", "Compara PDR y retardo del modo fast con WiFi (réplicas según --replications)", validateFastMode);
+    cmd.AddValue("routing", "Enrutamiento: flat (OLSR en todas las interfaces de los líderes), hierarchical (OLSR solo en backhaul, subredes de cluster vía HNA) u oracle (rutas ideales desde las posiciones, sin tráfico de control)", params.routing);
+    cmd.AddValue("recordMobility", "Graba las trayectorias generadas en una traza binaria", params.recordMobility);
+    cmd.AddValue("replayMobility", "Reproduce una traza binaria de movilidad (mmap) en lugar de generarla", params.replayMobility);
+    cmd.AddValue("profile", "Perfilado: tiempos por fase, eventos por origen y por segundo simulado, memoria pico (JSON)", params.profile);
+    cmd.AddValue("summaryFlows", "Incluir PDR y throughput por flujo en el resumen de la ejecución", params.summaryFlows);
+    cmd.AddValue("benchmark", "Ejecuta los escenarios de referencia (small/medium/large) y compara con los valores dorados", benchmarkMode);
+    cmd.AddValue("benchmarkScenarios", "Benchmark: escenarios a ejecutar", benchmarkScenarios);
+    cmd.AddValue("benchmarkRepeat", "Benchmark: repeticiones por escenario (se toma el mínimo de tiempo)", benchmarkRepeat);
+    cmd.AddValue("goldenFile", "Benchmark: archivo CSV con las métricas de referencia (por defecto, benchmark-golden.csv junto al .cc)", goldenFile);
+    cmd.AddValue("updateGolden", "Benchmark: reescribe el archivo de referencia con los resultados actuales", updateGolden);
+    cmd.AddValue("convertTrace", "Convierte una traza compacta a XML de NetAnim y termina", convertTrace);
+    cmd.AddValue("sweep", "Modo barrido: lanza una ejecución por combinación de parámetros", sweepMode);
+    cmd.AddValue("sweepClusters", "Barrido: lista de numClusters (p.ej. 2,3)", sweep.clusters);
+    cmd.AddValue("sweepNodes", "Barrido: lista de nodesPerCluster", sweep.nodes);
+    cmd.AddValue("sweepSpeeds", "Barrido: lista de leaderSpeed", sweep.speeds);
+    cmd.AddValue("sweepTrajectories", "Barrido: lista de trayectorias", sweep.trajectories);
+    cmd.AddValue("sweepRuns", "Barrido: lista de RngRun (por defecto 1..replications)", sweep.runs);
+    cmd.AddValue("replications", "Barrido: réplicas por configuración", sweep.replications);
+    cmd.AddValue("jobs", "Barrido/réplicas: procesos en paralelo (0 = todos los núcleos)", sweep.jobs);
+    cmd.AddValue("forkReplications", "Construye el escenario una vez y lanza N réplicas con fork() (RngRun = rngRun..rngRun+N-1)", params.forkReplications);
     cmd.Parse(argc, argv);
+    // --rngRun overrides the standard --RngRun global only when given explicitly
+    if (params.rngRun == 0) params.rngRun = RngSeedManager::GetRun();
+    else RngSeedManager::SetRun(params.rngRun);
 
     LogComponentEnable("ManetHierarchical_OpA", LOG_LEVEL_INFO);
 
     NS_LOG_INFO("MANET Jerárquica (Op A) - iniciando");
+    if (!convertTrace.empty()) return ConvertCompactTrace(convertTrace);
+    NS_ABORT_MSG_IF(params.trafficProfile != "onoff" && params.trafficProfile != "cbr" && params.trafficProfile != "poisson" &&
+                    params.trafficProfile != "bursty" && params.trafficProfile != "saturating",
+                    "--trafficProfile debe ser onoff, cbr, poisson, bursty o saturating: " << params.trafficProfile);
+    NS_ABORT_MSG_IF(params.trafficEndpoints != "leader" && params.trafficEndpoints != "subordinate" && params.trafficEndpoints != "mixed",
+                    "--trafficEndpoints debe ser leader, subordinate o mixed: " << params.trafficEndpoints);
+    NS_ABORT_MSG_IF(params.channel != "yans" && params.channel != "spectrum" && params.channel != "culled",
+                    "--channel debe ser yans, spectrum o culled: " << params.channel);
+    if (oracleSelfTest > 0) return RunOracleSelfTest(oracleSelfTest, 20000, oracleSelfTest <= 200 ? 1 : 500);
     std::string outDir = CreateOutputDirectory();
+    if (sweepMode) return RunSweep(params, sweep, argv[0], outDir);
+    if (validateFastMode) return ValidateFastMode(params, sweep, argv[0], outDir);
+    if (saturationSearch) return RunSaturationSearch(params, sweep, argv[0], outDir, saturationPdr);
+    if (benchmarkMode && goldenFile.empty()) goldenFile = outDir.substr(0, outDir.find_last_of('/') + 1) + "benchmark-golden.csv";
+    if (benchmarkMode) return RunBenchmark(params, benchmarkScenarios, benchmarkRepeat, goldenFile, updateGolden, argv[0], outDir);
+
+    auto wallStart = std::chrono::steady_clock::now();
+    PhaseTimer phases;
+    if (params.profile) {
+        ObjectFactory scheduler;
+        scheduler.SetTypeId(CountingMapScheduler::GetTypeId());
+        Simulator::SetScheduler(scheduler);
+    }
+    if (params.forkReplications > 0) params.enableAnim = false; // replicas would share the same trace files
+    if (!params.enableAnim) params.traceMode = "none";
+    if (params.layout != "manual" || params.numClusters > params.clusters.size()) {
+        if (params.layout == "manual") params.layout = "grid";
+        GenerateClusters(params);
+    }
+    for (ClusterConfig &c : params.clusters) {
+        if (params.nodesPerCluster > 0) c.numNodes = params.nodesPerCluster;
+        if (!params.trajectory.empty()) c.trajectoryType = params.trajectory;
+    }
+
+    phases.Mark("scenario");
 
      // Create nodes
     NodeContainer leaders;
@@ -337,43 +4573,84 @@ int main(int argc, char *argv[])
 
     NS_LOG_INFO("Total nodos: " << allNodes.GetN() << " (" << leaders.GetN() << " líderes + " << allSubordinates.GetN() << " subordinados)");
 
+    phases.Mark("nodes");
+
     // Mobility
-    SetupLeaderMobility(leaders, params.clusters, params.leaderSpeed);
-    for (uint32_t i=0;i<params.numClusters;++i) {
-        SetupSubordinateMobility(clusterSubs[i], leaders.Get(i), params.clusters[i].mobilityRadius, params.clusters[i].subordinateSpeed);
-        Simulator::Schedule(Seconds(0.5), &RepositionSubordinates, clusterSubs[i], leaders.Get(i), params.clusters[i].mobilityRadius);
+    if (!params.replayMobility.empty()) {
+        SetupReplayMobility(allNodes, params.replayMobility);
+    } else {
+        SetupLeaderMobility(leaders, params.clusters, params.leaderSpeed);
+        for (uint32_t i=0;i<params.numClusters;++i) {
+            SetupSubordinateMobility(clusterSubs[i], leaders.Get(i), params.clusters[i].mobilityRadius, params.clusters[i].subordinateSpeed);
+        }
     }
 
+    phases.Mark("mobility");
+
     // --- Physical WiFi setup ---
     WifiHelper wifi;
     wifi.SetStandard(WIFI_STANDARD_80211a);
     wifi.SetRemoteStationManager("ns3::ConstantRateWifiManager",
                                  "DataMode", StringValue("OfdmRate6Mbps"),
                                  "RtsCtsThreshold", UintegerValue(0));
-    YansWifiChannelHelper ch;
-    ch.SetPropagationDelay("ns3::ConstantSpeedPropagationDelayModel");
-    ch.AddPropagationLoss("ns3::FriisPropagationLossModel");
-    Ptr<YansWifiChannel> pch = ch.Create();
-    YansWifiPhyHelper phy;
-    phy.SetChannel(pch);
     WifiMacHelper mac;
     mac.SetType("ns3::AdhocWifiMac");
-
-    // Install access WiFi on ALL nodes (device 0)
-    NetDeviceContainer accessDevices = wifi.Install(phy, mac, allNodes);
-
-    // Backhaul for leaders (separate channel/PHY) -> device index 1 on leaders
-    YansWifiChannelHelper chBh;
-    chBh.SetPropagationDelay("ns3::ConstantSpeedPropagationDelayModel");
-    chBh.AddPropagationLoss("ns3::FriisPropagationLossModel");
-    Ptr<YansWifiChannel> pchBh = chBh.Create();
-    YansWifiPhyHelper phyBh;
-    phyBh.SetChannel(pchBh);
     WifiHelper wifiBh;
     wifiBh.SetStandard(WIFI_STANDARD_80211a);
     WifiMacHelper macBh;
     macBh.SetType("ns3::AdhocWifiMac");
-    NetDeviceContainer leaderBhDevices = wifiBh.Install(phyBh, macBh, leaders);
+    NetDeviceContainer accessDevices, leaderBhDevices;
+    double maxSpeed = params.leaderSpeed;
+    for (auto const &c : params.clusters) maxSpeed = std::max(maxSpeed, params.leaderSpeed + c.subordinateSpeed);
+    Ptr<RangeSimpleChannel> fastAccess, fastBh;
+
+    if (params.linkMode == "fast") {
+        // Abstract link layer on both tiers, same device order as WiFi (access = 0, backhaul = 1)
+        SimpleNetDeviceHelper simple;
+        simple.SetDeviceAttribute("DataRate", DataRateValue(DataRate(params.fastRate)));
+        fastAccess = CreateObject<RangeSimpleChannel>();
+        fastAccess->SetAttribute("Range", DoubleValue(params.accessRange));
+        fastAccess->SetAttribute("LossProbability", DoubleValue(params.fastLoss));
+        fastAccess->SetAttribute("MaxSpeed", DoubleValue(maxSpeed));
+        accessDevices = simple.Install(allNodes, fastAccess);
+        fastBh = CreateObject<RangeSimpleChannel>();
+        fastBh->SetAttribute("Range", DoubleValue(params.backhaulRange));
+        fastBh->SetAttribute("LossProbability", DoubleValue(params.fastLoss));
+        fastBh->SetAttribute("MaxSpeed", DoubleValue(params.leaderSpeed));
+        leaderBhDevices = simple.Install(leaders, fastBh);
+    } else if (params.channel == "spectrum" || params.channel == "culled") {
+        // SpectrumWifiPhy on both tiers; culled adds the range filter, spectrum is the same channel
+        // without it and is the baseline culled results should be compared against
+        bool cull = params.channel == "culled";
+        double threshold = cull ? ResolveCullThreshold(params.cullThreshold) : 0.0;
+        NS_LOG_UNCOND("Canal " << params.channel << ": SpectrumWifiPhy en lugar de YansWifiPhy"
+                      << (cull ? ", descarte por debajo de " + std::to_string(threshold) + " dBm" : std::string()));
+        SpectrumWifiPhyHelper phy;
+        phy.SetChannel(CreateCulledChannel(allNodes, 16.0206, threshold, maxSpeed, cull));
+        accessDevices = wifi.Install(phy, mac, allNodes);
+        SpectrumWifiPhyHelper phyBh;
+        phyBh.SetChannel(CreateCulledChannel(leaders, 23.0, threshold, params.leaderSpeed, cull));
+        leaderBhDevices = wifiBh.Install(phyBh, macBh, leaders);
+    } else {
+        YansWifiChannelHelper ch;
+        ch.SetPropagationDelay("ns3::ConstantSpeedPropagationDelayModel");
+        ch.AddPropagationLoss("ns3::FriisPropagationLossModel");
+        Ptr<YansWifiChannel> pch = ch.Create();
+        YansWifiPhyHelper phy;
+        phy.SetChannel(pch);
+
+        // Install access WiFi on ALL nodes (device 0)
+        accessDevices = wifi.Install(phy, mac, allNodes);
+
+        // Backhaul for leaders (separate channel/PHY) -> device index 1 on leaders
+        YansWifiChannelHelper chBh;
+        chBh.SetPropagationDelay("ns3::ConstantSpeedPropagationDelayModel");
+        chBh.AddPropagationLoss("ns3::FriisPropagationLossModel");
+        Ptr<YansWifiChannel> pchBh = chBh.Create();
+        YansWifiPhyHelper phyBh;
+        phyBh.SetChannel(pchBh);
+        leaderBhDevices = wifiBh.Install(phyBh, macBh, leaders);
+    }
 
     // Adjust tx power: access (lower) and backhaul (higher)
     for (uint32_t i=0;i<leaders.GetN();++i) {
@@ -398,6 +4675,8 @@ int main(int argc, char *argv[])
         devPerCluster[i] = c;
     }
 
+    phases.Mark("devices");
+
     // --- Install Internet stacks BEFORE Assigning IPs ---
     // Subordinates: basic stack (no global OLSR)
     InternetStackHelper stackSubs;
@@ -406,24 +4685,67 @@ int main(int argc, char *argv[])
     // Leaders: install OLSR (global)
     OlsrHelper olsr;
     Ipv4ListRoutingHelper list;
-    list.Add(olsr, 10);
+    Ipv4StaticRoutingHelper leaderStatic;
+    bool hierarchical = params.routing == "hierarchical";
+    std::unique_ptr<OracleRoutingDatabase> oracleDb;
+    if (params.routing == "oracle") {
+        // Shared shortest-path state; static routing handles the leader's own subnet
+        oracleDb.reset(new OracleRoutingDatabase(leaders.GetN()));
+        list.Add(leaderStatic, 0);
+        list.Add(OracleRoutingHelper(oracleDb.get()), 10);
+    } else if (hierarchical) {
+        // OLSR only on the backhaul; interface 1 is the access device (0 = loopback).
+        // Must precede list.Add(), which copies the helper
+        for (uint32_t i=0;i<leaders.GetN();++i) olsr.ExcludeInterface(leaders.Get(i), 1);
+        // Static routing below OLSR delivers into the leader's own (OLSR-excluded) cluster subnet
+        list.Add(leaderStatic, 0);
+    }
+    if (!oracleDb) list.Add(olsr, 10);
     InternetStackHelper stackLeaders;
     stackLeaders.SetRoutingHelper(list);
     stackLeaders.Install(leaders);
 
+    phases.Mark("stacks");
+
     // --- Assign IPs: separate subnets per cluster + backhaul subnet ---
     std::vector<Ipv4InterfaceContainer> ifacesPerCluster(params.numClusters);
     Ipv4AddressHelper ip;
     for (uint32_t i=0;i<params.numClusters;++i) {
-        std::ostringstream net; net << "10." << (i+1) << ".0.0";
-        ip.SetBase(net.str().c_str(), "255.255.255.0");
+        ip.SetBase(ClusterSubnet(i).c_str(), "255.255.255.0");
         ifacesPerCluster[i] = ip.Assign(devPerCluster[i]);
         ip.NewNetwork();
     }
     // Backhaul network among leaders
     Ipv4AddressHelper ipBh;
-    ipBh.SetBase("192.168.100.0", "255.255.255.0");
+    if (leaders.GetN() <= 253) ipBh.SetBase("192.168.100.0", "255.255.255.0");
+    else ipBh.SetBase("172.16.0.0", "255.255.0.0");
     Ipv4InterfaceContainer leaderBhIfaces = ipBh.Assign(leaderBhDevices);
+    if (hierarchical) {
+        // Each leader advertises its cluster subnet as an HNA aggregate and uses the backhaul as main interface
+        for (uint32_t i=0;i<leaders.GetN();++i) {
+            Ptr<Ipv4> ipv4 = leaders.Get(i)->GetObject<Ipv4>();
+            Ptr<Ipv4ListRouting> lr = DynamicCast<Ipv4ListRouting>(ipv4->GetRoutingProtocol());
+            for (uint32_t k=0; lr && k<lr->GetNRoutingProtocols(); ++k) {
+                int16_t priority;
+                Ptr<olsr::RoutingProtocol> agent = DynamicCast<olsr::RoutingProtocol>(lr->GetRoutingProtocol(k, priority));
+                if (!agent) continue;
+                agent->SetMainInterface(ipv4->GetInterfaceForDevice(leaderBhDevices.Get(i)));
+                agent->AddHostNetworkAssociation(Ipv4Address(ClusterSubnet(i).c_str()), Ipv4Mask("255.255.255.0"));
+            }
+        }
+    }
+    if (oracleDb) {
+        for (uint32_t i=0;i<leaders.GetN();++i) {
+            oracleDb->AddLeader(i, leaders.Get(i)->GetId(), leaderBhIfaces.GetAddress(i), Ipv4Address(ClusterSubnet(i).c_str()));
+        }
+    }
+    ControlPlaneCounter controlPlane;
+    controlPlane.Install(leaders);
+    FlowClassTable flowClasses;
+    for (uint32_t i=0;i<params.numClusters;++i) {
+        for (uint32_t j=0;j<ifacesPerCluster[i].GetN();++j) flowClasses.Add(ifacesPerCluster[i].GetAddress(j), i, false);
+        flowClasses.Add(leaderBhIfaces.GetAddress(i), i, true);
+    }
 
     // --- Static default routes in subordinates pointing to their leader IP (cluster-local) ---
     Ipv4StaticRoutingHelper staticHelper;
@@ -443,41 +4765,208 @@ int main(int argc, char *argv[])
         }
     }
 
+    phases.Mark("addressing");
+
     // --- Set up inter-cluster traffic (leaders) ---
-    SetupInterClusterTraffic(leaders, leaderBhIfaces, 5.0, params.simulationTime - 5.0);
+    std::vector<std::pair<uint32_t, uint32_t>> flows = BuildTrafficMatrix(params.clusters, params.numClusters, params.traffic, params.trafficK);
+    if (params.trafficEndpoints != "leader" && params.routing == "flat") {
+        NS_LOG_UNCOND("Aviso: con --routing=flat las subredes de los clusters no se anuncian; use hierarchical u oracle para extremos subordinados");
+    }
+    std::vector<TrafficFlow> endpoints = ResolveTrafficEndpoints(flows, leaders, leaderBhIfaces, clusterSubs, ifacesPerCluster, params.trafficEndpoints);
+    double offeredKbps = 0.0;
+    if (params.trafficProfile == "onoff") {
+        SetupInterClusterTraffic(endpoints, params.flowRate, 5.0, params.simulationTime - 5.0);
+        offeredKbps = endpoints.size() * DataRate(params.flowRate).GetBitRate() / 1000.0;
+    } else {
+        // 802.11a runs at OfdmRate6Mbps on both tiers
+        double lineRate = params.linkMode == "fast" ? DataRate(params.fastRate).GetBitRate() : 6e6;
+        offeredKbps = InstallTrafficEngine(endpoints, params.trafficProfile, DataRate(params.flowRate).GetBitRate(), lineRate,
+                                           params.burstOn, params.burstOff, 5.0, params.simulationTime - 5.0);
+    }
 
-    // --- Connectivity monitoring for leaders ---
-    ScheduleConnectivityMonitoring(leaders, 1.0, params.simulationTime, 300.0);
+    phases.Mark("applications");
 
-    // --- NetAnim visualization ---
-    AnimationInterface anim(outDir + "/manet-jerarquica-opA.xml");
-    for (uint32_t i=0;i<leaders.GetN();++i) {
-        anim.UpdateNodeDescription(leaders.Get(i), "Líder-" + std::to_string(i+1));
-        anim.UpdateNodeColor(leaders.Get(i), 255, 0, 0);
-        anim.UpdateNodeSize(leaders.Get(i)->GetId(), 8, 8);
+    // --- Connectivity monitoring: leaders on the backhaul, every node on the access tier ---
+    ConnectivityEngine leaderGrid(leaders, params.backhaulRange);
+    ConnectivityEngine accessGrid(allNodes, params.accessRange);
+    std::vector<uint32_t> heads;
+    for (uint32_t i=0;i<leaders.GetN();++i) heads.push_back(i);
+    for (uint32_t i=0;i<params.numClusters;++i) heads.insert(heads.end(), clusterSubs[i].GetN(), i);
+    accessGrid.SetHeads(heads);
+    std::unique_ptr<TwoTierGraphAnalytics> graph;
+    if (params.graphAnalytics) {
+        if (params.connectivityMode == "event") NS_LOG_UNCOND("--graphAnalytics usa los ticks del monitor periódico; se ignora con connectivityMode=event");
+        else graph.reset(new TwoTierGraphAnalytics(leaders.GetN(), heads));
     }
-    uint8_t colors[][3] = {{0,0,255},{0,255,0},{255,128,0}};
-    for (uint32_t i=0;i<params.numClusters;++i) {
-        for (uint32_t j=0;j<clusterSubs[i].GetN();++j) {
-            Ptr<Node> n = clusterSubs[i].Get(j);
-            anim.UpdateNodeDescription(n, "C" + std::to_string(i+1) + "-N" + std::to_string(j+1));
-            anim.UpdateNodeColor(n, colors[i%3][0], colors[i%3][1], colors[i%3][2]);
-            anim.UpdateNodeSize(n->GetId(), 5, 5);
+    if (params.connectivityMode != "event") {
+        ScheduleConnectivityMonitoring(&leaderGrid, &accessGrid, params.monitorInterval, params.simulationTime,
+                                       graph ? MakeCallback(&TwoTierGraphAnalytics::Sample, graph.get()) : ConnectivitySampleCallback());
+    }
+    std::unique_ptr<LinkEventTracker> linkTracker;
+    if (oracleDb || params.connectivityMode != "poll") {
+        linkTracker.reset(new LinkEventTracker(leaders, params.backhaulRange, params.simulationTime));
+        Simulator::ScheduleNow(&LinkEventTracker::Start, linkTracker.get());
+    }
+    if (oracleDb) {
+        // Runs after the tracker's Start(), which establishes the initial link states
+        Simulator::ScheduleNow(&OracleRoutingDatabase::Initialize, oracleDb.get(), linkTracker.get());
+        linkTracker->SetLinkChangeCallback(MakeCallback(&OracleRoutingDatabase::OnLinkChange, oracleDb.get()));
+    }
+
+    // --- NetAnim visualization (full XML) or compact delta trace ---
+    std::unique_ptr<AnimationInterface> anim;
+    // AnimationInterface fopen()s its animation and routing XML itself and writes them from the
+    // simulator thread; ns-3 offers no way to hand it another stream, so with traceMode=netanim
+    // those two files bypass `output`. traceMode=compact goes through the writer and
+    // --convertTrace rebuilds the same two XML files offline.
+    AsyncOutputWriter output(params.asyncOutput, params.compressOutput);
+    std::unique_ptr<CompactTraceWriter> compactTrace;
+    int traceSink = -1;
+    if (params.traceMode == "netanim") {
+        anim.reset(new AnimationInterface(outDir + "/manet-jerarquica-opA.xml"));
+    } else if (params.traceMode == "compact") {
+        traceSink = output.AddSink(outDir + "/manet-jerarquica-opA.trace");
+        compactTrace.reset(new CompactTraceWriter(output, traceSink, params.traceMinMove, 0.25, 1.0, params.simulationTime));
+    }
+    auto describeNode = [&](Ptr<Node> n, const std::string &descr, uint8_t r, uint8_t g, uint8_t b, uint8_t size) {
+        if (anim) {
+            anim->UpdateNodeDescription(n, descr);
+            anim->UpdateNodeColor(n, r, g, b);
+            anim->UpdateNodeSize(n->GetId(), size, size);
+        }
+        if (compactTrace) compactTrace->SetNodeInfo(n, descr, r, g, b, size);
+    };
+    if (anim || compactTrace) {
+        for (uint32_t i=0;i<leaders.GetN();++i) {
+            describeNode(leaders.Get(i), "Líder-" + std::to_string(i+1), 255, 0, 0, 8);
+            // NetAnim subscribes to CourseChange: emit waypoint notifications only in this case
+            Ptr<LeaderTrajectoryMobilityModel> lm = leaders.Get(i)->GetObject<LeaderTrajectoryMobilityModel>();
+            if (lm && anim) lm->EnableCourseChangeNotifications(true);
+        }
+        uint8_t colors[][3] = {{0,0,255},{0,255,0},{255,128,0}};
+        for (uint32_t i=0;i<params.numClusters;++i) {
+            for (uint32_t j=0;j<clusterSubs[i].GetN();++j) {
+                describeNode(clusterSubs[i].Get(j), "C" + std::to_string(i+1) + "-N" + std::to_string(j+1), colors[i%3][0], colors[i%3][1], colors[i%3][2], 5);
+                Ptr<GroupMemberMobilityModel> gm = clusterSubs[i].Get(j)->GetObject<GroupMemberMobilityModel>();
+                if (gm && anim) gm->EnableCourseChangeNotifications(true);
+            }
         }
     }
-    anim.EnablePacketMetadata(true);
-    anim.EnableIpv4RouteTracking(outDir + "/manet-jerarquica-opA-routes.xml", Seconds(0), Seconds(params.simulationTime), Seconds(1));
+    if (anim) {
+        anim->EnablePacketMetadata(true);
+        anim->EnableIpv4RouteTracking(outDir + "/manet-jerarquica-opA-routes.xml", Seconds(0), Seconds(params.simulationTime), Seconds(1));
+    }
+    if (compactTrace) compactTrace->Start(allNodes);
     // FlowMonitor
     FlowMonitorHelper flowmon;
     Ptr<FlowMonitor> monitor = flowmon.InstallAll();
+    Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier());
+
+    // --- Fork-after-setup replications: each child reseeds every random stream and runs ---
+    if (params.forkReplications > 0) {
+        uint32_t failedReplicas = 0;
+        int32_t replica = ForkReplicas(params.forkReplications, sweep.jobs, outDir + "/fork", failedReplicas);
+        if (replica < 0) {
+            Simulator::Destroy();
+            return failedReplicas > 0 ? 1 : 0;
+        }
+        params.rngRun += replica;
+        params.summaryFile = outDir + "/fork/run-" + std::to_string(replica) + ".csv";
+        RngSeedManager::SetRun(params.rngRun);
+        // SetStream() rebuilds each generator from the current run number
+        int64_t stream = 1;
+        for (uint32_t i=0;i<allNodes.GetN();++i) {
+            Ptr<MobilityModel> m = allNodes.Get(i)->GetObject<MobilityModel>();
+            if (m) stream += m->AssignStreams(stream);
+        }
+        stream += wifi.AssignStreams(accessDevices, stream);
+        stream += wifiBh.AssignStreams(leaderBhDevices, stream);
+        if (fastAccess) stream += fastAccess->AssignStreams(stream);
+        if (fastBh) stream += fastBh->AssignStreams(stream);
+        stream += stackSubs.AssignStreams(allSubordinates, stream);
+        stream += stackLeaders.AssignStreams(leaders, stream);
+        stream += olsr.AssignStreams(leaders, stream);
+        for (uint32_t i=0;i<allNodes.GetN();++i) {
+            Ptr<Node> n = allNodes.Get(i);
+            for (uint32_t a=0;a<n->GetNApplications();++a) {
+                Ptr<OnOffApplication> app = DynamicCast<OnOffApplication>(n->GetApplication(a));
+                if (app) stream += app->AssignStreams(stream);
+                Ptr<MultiFlowSource> src = DynamicCast<MultiFlowSource>(n->GetApplication(a));
+                if (src) stream += src->AssignStreams(stream);
+            }
+        }
+        NS_LOG_INFO("Réplica " << replica << ": RngRun=" << params.rngRun);
+    }
+
+    // Report sinks are opened after the fork so that each replica owns its files; the writer
+    // thread is started last because fork() would not carry it into the children
+    std::set<std::string> outputs;
+    for (const std::string &o : SplitList(params.outputs)) outputs.insert(o);
+    int reportSink = outputs.count("report") ? output.AddSink("-") : -1;
+    int flowsSink = -1;
+    if (outputs.count("flows")) {
+        std::string suffix = params.forkReplications > 0 ? "-r" + std::to_string(params.rngRun) : "";
+        flowsSink = output.AddSink(outDir + "/manet-jerarquica-opA-flows" + suffix + ".txt");
+    }
+    std::unique_ptr<WindowedFlowMetrics> windowed;
+    std::unique_ptr<SteadyStateDetector> steady;
+    if (params.steadyState && params.metricsWindow <= 0) NS_LOG_UNCOND("--steadyState requiere --metricsWindow > 0; se ignora");
+    if ((outputs.count("windows") || params.steadyState) && params.metricsWindow > 0) {
+        int windowsSink = -1;
+        if (outputs.count("windows")) {
+            std::string suffix = params.forkReplications > 0 ? "-r" + std::to_string(params.rngRun) : "";
+            windowsSink = output.AddSink(outDir + "/manet-jerarquica-opA-windows" + suffix + ".csv");
+        }
+        windowed.reset(new WindowedFlowMetrics(monitor, classifier, flowClasses, params.numClusters, params.metricsWindow,
+                                               params.simulationTime, output, windowsSink));
+        if (params.steadyState) {
+            steady.reset(new SteadyStateDetector({"throughputKbps", "pdr", "delayMs", "leaderConnectivity"},
+                                                 params.steadyPrecision, params.steadyWarmup, params.steadyBatches));
+            SteadyStateDetector *detector = steady.get();
+            auto lastChecks = std::make_shared<std::pair<uint32_t, uint32_t>>(0, 0);
+            windowed->SetWindowCallback([detector, lastChecks] (double t, double dt, const WindowedFlowMetrics::Counters &c) {
+                const double none = std::numeric_limits<double>::quiet_NaN();
+                // Leader connectivity over the window, from the poll monitor's counters
+                uint32_t checks = globalConnectivity.totalChecks - lastChecks->first;
+                uint32_t connected = globalConnectivity.connectedChecks - lastChecks->second;
+                *lastChecks = {globalConnectivity.totalChecks, globalConnectivity.connectedChecks};
+                detector->Observe(t, {c.rxBytes * 8.0 / dt / 1000.0,
+                                      c.txPackets > 0 ? c.rxPackets * 100.0 / c.txPackets : none,
+                                      c.rxPackets > 0 ? c.delay * 1000.0 / c.rxPackets : none,
+                                      checks > 0 ? connected * 100.0 / checks : none});
+            });
+        }
+        windowed->Start();
+    }
+    if (graph) {
+        int graphSink = -1;
+        if (outputs.count("graph")) {
+            std::string suffix = params.forkReplications > 0 ? "-r" + std::to_string(params.rngRun) : "";
+            graphSink = output.AddSink(outDir + "/manet-jerarquica-opA-graph" + suffix + ".csv");
+        }
+        graph->SetOutput(&output, graphSink);
+    }
+    output.Start();
+    if (!params.recordMobility.empty()) {
+        std::string suffix = params.forkReplications > 0 ? "-r" + std::to_string(params.rngRun) : "";
+        RecordMobilityTrace(allNodes, params.simulationTime, params.recordMobility + suffix);
+    }
+
+    phases.Mark("instrumentation");
 
     // Run simulation
     Simulator::Stop(Seconds(params.simulationTime));
     Simulator::Run();
+    phases.Mark("run");
 
     // Analysis
+    if (linkTracker) linkTracker->Finalize();
+    if (windowed) windowed->Finish();
+    if (compactTrace) {
+        output.Flush(traceSink);
+        NS_LOG_INFO("Traza compacta: " << compactTrace->GetRecords() << " registros (convertir con --convertTrace=" << output.GetPath(traceSink) << ")");
+    }
     monitor->CheckForLostPackets();
-    Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier());
     std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats();
 
     uint32_t totalTx=0, totalRx=0;
@@ -485,35 +4974,108 @@ int main(int argc, char *argv[])
     uint32_t interTx=0, interRx=0;
     double interThroughput=0.0;
     uint32_t interFlows=0;
+    double delaySum=0.0;
+    std::vector<std::pair<std::string, double>> flowMetrics;
 
-    std::cout << "\n--- Flujos detectados ---\n";
+    std::ostringstream report;
+    report << "\n--- Flujos detectados ---\n";
     for (auto const &entry : stats) {
         if (entry.second.txPackets == 0) continue;
         Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow(entry.first);
-        double thr = entry.second.rxBytes * 8.0 / (params.simulationTime - 5.0) / 1000.0;
+        // Throughput over the flow's own active period (first TX to last RX)
+        double duration = (entry.second.timeLastRxPacket - entry.second.timeFirstTxPacket).GetSeconds();
+        double thr = duration > 0 ? entry.second.rxBytes * 8.0 / duration / 1000.0 : 0.0;
         double pdr = (entry.second.rxPackets * 100.0) / entry.second.txPackets;
         double delay = entry.second.rxPackets > 0 ? entry.second.delaySum.GetSeconds() / entry.second.rxPackets : 0.0;
 
-        std::cout << "Flow " << entry.first << ": " << t.sourceAddress << " -> " << t.destinationAddress << "\n";
-        std::cout << "  TX/RX: " << entry.second.txPackets << "/" << entry.second.rxPackets << "  PDR: " << pdr << "%  Throughput: " << thr << " kbps  Delay(ms): " << delay*1000.0 << "\n";
+        report << "Flow " << entry.first << ": " << t.sourceAddress << " -> " << t.destinationAddress << "\n";
+        report << "  TX/RX: " << entry.second.txPackets << "/" << entry.second.rxPackets << "  PDR: " << pdr << "%  Throughput: " << thr << " kbps  Delay(ms): " << delay*1000.0 << "\n";
+        if (params.summaryFlows) {
+            flowMetrics.push_back({"flow" + std::to_string(entry.first) + "Pdr", pdr});
+            flowMetrics.push_back({"flow" + std::to_string(entry.first) + "ThroughputKbps", thr});
+        }
 
         totalTx += entry.second.txPackets;
         totalRx += entry.second.rxPackets;
         totalThroughput += thr;
+        delaySum += entry.second.delaySum.GetSeconds();
 
-        bool isInter = false;
-        for (uint32_t i=0;i<leaders.GetN();++i) {
-            Ipv4Address a = leaderBhIfaces.GetAddress(i);
-            if (t.sourceAddress == a || t.destinationAddress == a) { isInter = true; break; }
+        FlowClass fc = flowClasses.Classify(t.sourceAddress, t.destinationAddress);
+        if (fc != FLOW_INTRA) {
+            interTx += entry.second.txPackets; interRx += entry.second.rxPackets; interThroughput += thr; interFlows++;
+            report << (fc == FLOW_BACKHAUL ? "  [BACKHAUL]\n" : "  [INTER-CLUSTER]\n");
         }
-        if (isInter) { interTx += entry.second.txPackets; interRx += entry.second.rxPackets; interThroughput += thr; interFlows++; std::cout << "  [INTER-CLUSTER]\n"; }
     }
 
-    std::cout << "\nResumen:\nTotal TX: " << totalTx << "  Total RX: " << totalRx << "  PDR geral: ";
-    if (totalTx>0) std::cout << (totalRx*100.0/totalTx) << "%\n"; else std::cout << "N/A\n";
-    std::cout << "Throughput total(kbps): " << totalThroughput << "\n";
-    std::cout << "Líderes: mediciones totales: " << globalConnectivity.totalChecks << " conectadas: " << globalConnectivity.connectedChecks << " Ratio: " << (globalConnectivity.GetConnectivityRatio()*100.0) << "%\n";
+    report << "\nResumen:\nTotal TX: " << totalTx << "  Total RX: " << totalRx << "  PDR geral: ";
+    if (totalTx>0) report << (totalRx*100.0/totalTx) << "%\n"; else report << "N/A\n";
+    report << "Throughput total(kbps): " << totalThroughput << "\n";
+    report << "Líderes: mediciones totales: " << globalConnectivity.totalChecks << " conectadas: " << globalConnectivity.connectedChecks << " Ratio: " << (globalConnectivity.GetConnectivityRatio()*100.0) << "%\n";
+    if (linkTracker) linkTracker->Print(report, Simulator::Now().GetSeconds());
+    if (steady) steady->Print(report);
+    if (graph) graph->Print(report);
+    controlPlane.Print(report);
+    if (oracleDb) oracleDb->Print(report);
+    report << "Subordinados: dentro del alcance de su líder: " << (globalConnectivity.GetAttachmentRatio()*100.0) << "%  enlaces de acceso/medición: " << (globalConnectivity.totalChecks > 0 ? (double)globalConnectivity.accessLinkSamples / globalConnectivity.totalChecks : 0.0) << "\n";
 
+    if (reportSink >= 0) output.Write(reportSink, report.str());
+    if (flowsSink >= 0) output.Write(flowsSink, report.str());
+    output.Close();
+
+    if (!params.summaryFile.empty()) {
+        RunSummary summary;
+        summary.config = {{"numClusters", std::to_string(params.numClusters)},
+                          {"nodesPerCluster", std::to_string(params.nodesPerCluster)},
+                          {"leaderSpeed", std::to_string(params.leaderSpeed)},
+                          {"trajectory", params.trajectory.empty() ? "config" : params.trajectory},
+                          {"rngRun", std::to_string(params.rngRun)}};
+        summary.metrics = {{"txPackets", (double)totalTx},
+                           {"rxPackets", (double)totalRx},
+                           {"pdr", totalTx > 0 ? totalRx*100.0/totalTx : 0.0},
+                           {"throughputKbps", totalThroughput},
+                           {"offeredKbps", offeredKbps},
+                           {"meanDelayMs", totalRx > 0 ? delaySum*1000.0/totalRx : 0.0},
+                           {"interFlows", (double)interFlows},
+                           {"interPdr", interTx > 0 ? interRx*100.0/interTx : 0.0},
+                           {"leaderConnectivity", globalConnectivity.GetConnectivityRatio()*100.0},
+                           {"subordinateAttachment", globalConnectivity.GetAttachmentRatio()*100.0}};
+        summary.metrics.push_back({"controlBytesAccess", (double)controlPlane.GetBytes(ControlPlaneCounter::ACCESS)});
+        summary.metrics.push_back({"controlBytesBackhaul", (double)controlPlane.GetBytes(ControlPlaneCounter::BACKHAUL)});
+        if (linkTracker) {
+            summary.metrics.push_back({"linkTransitions", (double)linkTracker->GetTransitions()});
+            summary.metrics.push_back({"partitionedTime", linkTracker->GetPartitionedTime()});
+        }
+        if (graph) {
+            summary.metrics.push_back({"graphComponents", graph->GetMeanComponents()});
+            summary.metrics.push_back({"graphLargestComponent", graph->GetMeanLargestComponent()});
+            summary.metrics.push_back({"clusterReachability", graph->GetMeanClusterReachability()});
+            summary.metrics.push_back({"nodeReachability", graph->GetMeanNodeReachability()});
+            summary.metrics.push_back({"detachEvents", (double)graph->GetDetachEvents()});
+            summary.metrics.push_back({"articulationLeaders", graph->GetMeanArticulationLeaders()});
+        }
+        if (steady) {
+            summary.metrics.push_back({"steadyConverged", steady->Converged() ? 1.0 : 0.0});
+            summary.metrics.push_back({"steadyWarmup", steady->GetWarmup()});
+            summary.metrics.push_back({"steadyStopTime", Simulator::Now().GetSeconds()});
+            for (auto const &e : steady->GetEstimates()) {
+                std::string name = "steady" + std::string(1, std::toupper(e.name[0])) + e.name.substr(1);
+                summary.metrics.push_back({name, e.mean});
+                summary.metrics.push_back({name + "Ci95", e.halfWidth});
+            }
+        }
+        summary.metrics.insert(summary.metrics.end(), flowMetrics.begin(), flowMetrics.end());
+        summary.metrics.push_back({"events", (double)Simulator::GetEventCount()});
+        summary.metrics.push_back({"runSeconds", phases.Get("run")});
+        summary.metrics.push_back({"wallSeconds", std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count()});
+        WriteRunSummary(params.summaryFile, summary);
+    }
+
+    phases.Mark("analysis");
+    if (params.profile) {
+        std::string base = params.summaryFile.empty() ? outDir + "/manet-jerarquica-opA" : params.summaryFile.substr(0, params.summaryFile.rfind('.'));
+        WriteProfileJson(base + "-profile.json", phases, params, allNodes.GetN());
+        NS_LOG_INFO("Perfil: " << base << "-profile.json");
+    }
     Simulator::Destroy();
     //NS_LOG_INFO("Simulación finalizada. Archivos: manet-jerarquica-opA.xml y manet-jerarquica-opA-routes.xml");
     NS_LOG_INFO("Simulación finalizada. Archivos en: " << outDir);